@@ -0,0 +1,407 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// =======================================================================
+// ==            BATCH SCRIPT LOADER (io_uring)                         ==
+// =======================================================================
+// Reads many small files without one blocking open/stat/read/close round
+// trip per file. The calling thread keeps up to `queue_depth` files in flight
+// on an io_uring: for each file it submits openat and statx together, then a
+// read sized from statx, then close, and many files' steps go down in a
+// single io_uring_enter. Every finished file is pushed straight onto a queue
+// drained by worker threads, which lex and run it while I/O continues.
+//
+// If the kernel refuses io_uring (old kernel, seccomp, container policy), or
+// has it without openat, statx or close (before 5.6), the workers instead
+// each take the next path, read it with blocking calls, and process it, so
+// I/O still overlaps across threads.
+
+struct Loaded_file {
+    std::string path;
+    std::string contents;
+    int error = 0; // errno of the failing step, 0 on success
+};
+
+// A blocking multi-consumer queue; pop() returns nullopt once closed and empty.
+template <typename T>
+class Work_queue {
+public:
+    void push(T item) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_items.push_back(std::move(item));
+        }
+        m_ready.notify_one();
+    }
+
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_ready.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) return std::nullopt;
+        T item = std::move(m_items.front());
+        m_items.pop_front();
+        return item;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_ready.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::deque<T> m_items;
+    bool m_closed = false;
+};
+
+// A minimal io_uring: just the ring mappings and the four operations the
+// loader needs, talking to the kernel through raw syscalls.
+class Io_ring {
+public:
+    explicit Io_ring(unsigned entries) {
+        io_uring_params params{};
+        m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0) throw std::runtime_error(std::string("io_uring_setup: ") + std::strerror(errno));
+
+        m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+
+        m_sq_ring = map(m_sq_size, IORING_OFF_SQ_RING);
+        m_cq_ring = single ? m_sq_ring : map(m_cq_size, IORING_OFF_CQ_RING);
+        m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe*>(map(m_sqes_size, IORING_OFF_SQES));
+
+        char* sq = static_cast<char*>(m_sq_ring);
+        m_sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        m_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        m_sq_entries = params.sq_entries;
+        m_local_tail = *m_sq_tail;
+
+        char* cq = static_cast<char*>(m_cq_ring);
+        m_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~Io_ring() {
+        if (m_sqes) ::munmap(m_sqes, m_sqes_size);
+        if (m_cq_ring && m_cq_ring != m_sq_ring) ::munmap(m_cq_ring, m_cq_size);
+        if (m_sq_ring) ::munmap(m_sq_ring, m_sq_size);
+        if (m_fd >= 0) ::close(m_fd);
+    }
+
+    Io_ring(const Io_ring&) = delete;
+    Io_ring& operator=(const Io_ring&) = delete;
+
+    unsigned capacity() const { return m_sq_entries; }
+
+    // Whether the kernel supports every one of `ops`. A kernel too old to
+    // answer the probe is too old for openat, statx and close as well.
+    bool supports(std::initializer_list<uint8_t> ops) const {
+        constexpr unsigned MAX_OPS = 256;
+        std::vector<char> buffer(sizeof(io_uring_probe) + MAX_OPS * sizeof(io_uring_probe_op)); // Zeroed, as the kernel requires
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, MAX_OPS) < 0) return false;
+        for (uint8_t op : ops) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    void open(const char* path, uint64_t user_data) {
+        io_uring_sqe& sqe = next_sqe(IORING_OP_OPENAT, user_data);
+        sqe.fd = AT_FDCWD;
+        sqe.addr = reinterpret_cast<uint64_t>(path);
+        sqe.open_flags = O_RDONLY | O_CLOEXEC;
+    }
+
+    void statx(const char* path, struct statx* out, uint64_t user_data) {
+        io_uring_sqe& sqe = next_sqe(IORING_OP_STATX, user_data);
+        sqe.fd = AT_FDCWD;
+        sqe.addr = reinterpret_cast<uint64_t>(path);
+        sqe.len = STATX_SIZE;
+        sqe.off = reinterpret_cast<uint64_t>(out);
+    }
+
+    void read(int fd, char* buffer, unsigned length, uint64_t offset, uint64_t user_data) {
+        io_uring_sqe& sqe = next_sqe(IORING_OP_READ, user_data);
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<uint64_t>(buffer);
+        sqe.len = length;
+        sqe.off = offset;
+    }
+
+    void close(int fd, uint64_t user_data) {
+        io_uring_sqe& sqe = next_sqe(IORING_OP_CLOSE, user_data);
+        sqe.fd = fd;
+    }
+
+    // Submits everything queued and waits for at least `wait_for` completions.
+    void submit(unsigned wait_for) {
+        __atomic_store_n(m_sq_tail, m_local_tail, __ATOMIC_RELEASE); // Publish the filled entries
+        unsigned to_submit = m_queued;
+        m_queued = 0;
+        while (true) {
+            long r = ::syscall(__NR_io_uring_enter, m_fd, to_submit, wait_for, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r >= 0) return;
+            if (errno != EINTR) throw std::runtime_error(std::string("io_uring_enter: ") + std::strerror(errno));
+            to_submit = 0; // Already consumed by the kernel before the signal
+        }
+    }
+
+    // Calls handle(user_data, result) for every completion that has arrived.
+    template <typename Handler>
+    void reap(Handler&& handle) {
+        unsigned head = *m_cq_head;
+        unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = m_cqes[head & m_cq_mask];
+            handle(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+    }
+
+private:
+    int m_fd = -1;
+    void* m_sq_ring = nullptr;
+    void* m_cq_ring = nullptr;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sq_size = 0, m_cq_size = 0, m_sqes_size = 0;
+    unsigned *m_sq_head, *m_sq_tail, *m_sq_array;
+    unsigned *m_cq_head, *m_cq_tail;
+    unsigned m_sq_mask, m_cq_mask, m_sq_entries;
+    io_uring_cqe* m_cqes;
+    unsigned m_queued = 0;
+    unsigned m_local_tail = 0; // Entries up to here are filled but not yet visible to the kernel
+
+    void* map(size_t size, off_t offset) {
+        void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+        if (p == MAP_FAILED) throw std::runtime_error(std::string("io_uring mmap: ") + std::strerror(errno));
+        return p;
+    }
+
+    io_uring_sqe& next_sqe(uint8_t opcode, uint64_t user_data) {
+        if (m_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries) {
+            submit(0); // Ring full: hand what we have to the kernel first
+        }
+        unsigned index = m_local_tail++ & m_sq_mask;
+        io_uring_sqe& sqe = m_sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.user_data = user_data;
+        m_sq_array[index] = index;
+        m_queued++;
+        return sqe;
+    }
+};
+
+class Batch_loader {
+public:
+    using Process = std::function<void(Loaded_file&)>;
+
+    explicit Batch_loader(unsigned workers = std::max(1u, std::thread::hardware_concurrency()),
+                          unsigned queue_depth = 256)
+        : m_workers(workers), m_queue_depth(queue_depth) {}
+
+    // True if the last load_all() went through io_uring.
+    bool used_io_uring() const { return m_used_io_uring; }
+
+    // Loads every path and calls process() on a worker thread for each, in
+    // completion order. Returns when all files have been processed.
+    void load_all(const std::vector<std::string>& paths, const Process& process) {
+        Work_queue<Loaded_file> loaded;
+        Work_queue<size_t> unread; // Only used by the fallback
+        std::optional<Io_ring> ring;
+        if (paths.empty()) return;
+        try {
+            ring.emplace(m_queue_depth * 2);
+            if (!ring->supports({IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE})) ring.reset();
+        } catch (const std::runtime_error&) {
+            ring.reset();
+        }
+        m_used_io_uring = ring.has_value();
+
+        // However this returns, the queues are closed and the workers joined,
+        // so a failing io_uring_enter leaves no thread behind.
+        std::vector<std::thread> workers;
+        struct Join_workers {
+            std::vector<std::thread>& workers;
+            Work_queue<Loaded_file>& loaded;
+            Work_queue<size_t>& unread;
+            ~Join_workers() {
+                loaded.close();
+                unread.close();
+                for (auto& worker : workers) worker.join();
+            }
+        } join_workers{workers, loaded, unread};
+        for (unsigned i = 0; i < m_workers; i++) {
+            workers.emplace_back([&] {
+                if (!m_used_io_uring) {
+                    while (auto index = unread.pop()) {
+                        Loaded_file file = read_blocking(paths[*index]);
+                        process(file);
+                    }
+                    return;
+                }
+                while (auto file = loaded.pop()) process(*file);
+            });
+        }
+
+        if (m_used_io_uring) {
+            read_with_ring(*ring, paths, loaded);
+        } else {
+            for (size_t i = 0; i < paths.size(); i++) unread.push(i);
+        }
+    }
+
+private:
+    unsigned m_workers;
+    unsigned m_queue_depth;
+    bool m_used_io_uring = false;
+
+    // One file's progress through open+statx -> read(s) -> close.
+    struct In_flight {
+        size_t index = 0;
+        int fd = -1;
+        int pending = 0;        // Operations submitted but not yet completed
+        bool stat_done = false;
+        struct statx stx {};
+        uint64_t size = 0;      // From statx; 0 means "read until EOF"
+        size_t received = 0;    // Bytes read so far
+        Loaded_file file;
+    };
+
+    enum Step : uint64_t { OPEN = 0, STAT = 1, READ = 2, CLOSE = 3 };
+    static constexpr size_t READ_CHUNK = 64 * 1024;
+
+    static uint64_t tag(size_t slot, Step step) { return (static_cast<uint64_t>(slot) << 2) | step; }
+
+    void read_with_ring(Io_ring& ring, const std::vector<std::string>& paths, Work_queue<Loaded_file>& loaded) {
+        std::vector<In_flight> slots(std::min<size_t>(m_queue_depth, paths.size()));
+        std::vector<size_t> free_slots;
+        for (size_t i = slots.size(); i-- > 0;) free_slots.push_back(i);
+        size_t next_path = 0;
+        size_t finished = 0;
+
+        auto start_file = [&](size_t slot) {
+            In_flight& f = slots[slot];
+            f = In_flight();
+            f.index = next_path++;
+            f.file.path = paths[f.index];
+            f.pending = 2;
+            ring.open(f.file.path.c_str(), tag(slot, OPEN));
+            ring.statx(f.file.path.c_str(), &f.stx, tag(slot, STAT));
+        };
+        auto issue_read = [&](size_t slot) {
+            In_flight& f = slots[slot];
+            size_t want = f.size ? f.size - f.received : READ_CHUNK;
+            f.file.contents.resize(f.received + want);
+            f.pending++;
+            ring.read(f.fd, f.file.contents.data() + f.received, static_cast<unsigned>(want), f.received, tag(slot, READ));
+        };
+        auto finish_reading = [&](size_t slot) {
+            In_flight& f = slots[slot];
+            if (f.fd >= 0) {
+                f.pending++;
+                ring.close(f.fd, tag(slot, CLOSE));
+                f.fd = -1;
+            }
+        };
+
+        while (finished < paths.size()) {
+            while (!free_slots.empty() && next_path < paths.size()) {
+                start_file(free_slots.back());
+                free_slots.pop_back();
+            }
+            ring.submit(1);
+            ring.reap([&](uint64_t user_data, int res) {
+                size_t slot = user_data >> 2;
+                In_flight& f = slots[slot];
+                f.pending--;
+                switch (static_cast<Step>(user_data & 3)) {
+                    case OPEN:
+                        if (res < 0) f.file.error = -res;
+                        else f.fd = res;
+                        break;
+                    case STAT:
+                        f.stat_done = true;
+                        if (res < 0 && !f.file.error) f.file.error = -res;
+                        else if (res == 0) f.size = f.stx.stx_size;
+                        break;
+                    case READ:
+                        if (res < 0) f.file.error = -res;
+                        else f.received += static_cast<size_t>(res);
+                        if (res <= 0 || (f.size && f.received >= f.size)) {
+                            f.file.contents.resize(f.received); // Trim the unused tail
+                            finish_reading(slot);
+                        } else {
+                            issue_read(slot); // Short read, or size unknown: keep going
+                        }
+                        break;
+                    case CLOSE:
+                        break;
+                }
+                // Both open and statx are back: start reading (or give up).
+                if ((user_data & 3) <= STAT && f.pending == 0) {
+                    if (f.file.error) finish_reading(slot);
+                    else issue_read(slot);
+                }
+                if (f.pending == 0 && f.fd < 0) {
+                    loaded.push(std::move(f.file));
+                    free_slots.push_back(slot);
+                    finished++;
+                }
+            });
+        }
+    }
+
+    static Loaded_file read_blocking(const std::string& path) {
+        Loaded_file file;
+        file.path = path;
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) { file.error = errno; return file; }
+        struct stat st {};
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) file.contents.reserve(static_cast<size_t>(st.st_size));
+        char buffer[READ_CHUNK];
+        while (true) {
+            ssize_t n = ::read(fd, buffer, sizeof(buffer));
+            if (n > 0) { file.contents.append(buffer, static_cast<size_t>(n)); continue; }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) file.error = errno;
+            break;
+        }
+        ::close(fd);
+        return file;
+    }
+};
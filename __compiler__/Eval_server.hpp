@@ -0,0 +1,617 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// =======================================================================
+// ==          LOCAL EVALUATION SERVER (Unix Domain Socket)             ==
+// =======================================================================
+// A long-running process that evaluates SimPL programs for other processes
+// on the same host, so they skip process start-up and re-compilation.
+//
+// Wire format (host byte order, since both ends share a machine). Every
+// message is a frame: u32 payload length, then the payload.
+//
+//   request:  u32 request_id | u8 kind | u64 program_id | u32 input_count |
+//             f64 inputs[input_count] | text bytes (every kind but RUN_CACHED)
+//   response: u32 request_id | u8 status | u64 program_id | output bytes
+//
+// RUN_SOURCE compiles (or finds in the cache) the program and returns its id;
+// later requests can send RUN_CACHED with just that id and new inputs.
+// PUBLISH_RULE ("<name>\n<source>") installs a program under a name, replacing
+// any previous version without pausing requests already running it, and
+// RUN_RULE ("<name>") runs whatever version is current.
+//
+// One thread owns epoll and all sockets. Each wake-up gathers every complete
+// request from every ready connection and queues them for a set of
+// evaluator threads, each of which takes one request at a time. Meanwhile
+// the epoll thread goes on accepting, reading and writing, and a slow
+// program holds only the thread running it, so it never stalls the other
+// requests. Finished requests come back through a queue and an eventfd, and
+// everything finished by the time the epoll thread wakes is written with a
+// single send per connection. What "evaluate" means is up to the handler
+// passed in.
+//
+// A connection may have MAX_PIPELINED requests unanswered; past that, or
+// while its responses are not being read, it is not read from, so neither
+// its input nor its output grows without bound. A client that shuts down
+// its sending side still gets the answers to everything it sent. When the
+// process runs out of descriptors, accepting pauses until a connection
+// closes (or a moment passes) instead of spinning on the listener.
+
+enum class Request_kind : uint8_t { RUN_SOURCE = 0, RUN_CACHED = 1, PUBLISH_RULE = 2, RUN_RULE = 3 };
+enum class Response_status : uint8_t { OK = 0, ERROR = 1, UNKNOWN_PROGRAM = 2 };
+
+struct Eval_request {
+    uint32_t id = 0;
+    Request_kind kind = Request_kind::RUN_SOURCE;
+    uint64_t program_id = 0;
+    std::vector<double> inputs;
+    std::string source;
+};
+
+struct Eval_response {
+    uint32_t id = 0;
+    Response_status status = Response_status::OK;
+    uint64_t program_id = 0;
+    std::string output;
+};
+
+// Largest payload either side will accept, to bound memory per connection.
+constexpr uint32_t MAX_FRAME_SIZE = 16u << 20;
+
+// Most requests one connection may have waiting for their responses.
+constexpr uint32_t MAX_PIPELINED = 64;
+
+// FNV-1a, used as the program cache key.
+inline uint64_t hash_program(std::string_view source) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : source) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+namespace wire {
+
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T get(const char*& p, const char* end) {
+    if (static_cast<size_t>(end - p) < sizeof(T)) throw std::runtime_error("Truncated frame.");
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+}
+
+inline void encode_request(std::string& out, const Eval_request& r) {
+    size_t header = out.size();
+    put<uint32_t>(out, 0);
+    put(out, r.id);
+    put(out, static_cast<uint8_t>(r.kind));
+    put(out, r.program_id);
+    put(out, static_cast<uint32_t>(r.inputs.size()));
+    for (double d : r.inputs) put(out, d);
+    if (r.kind != Request_kind::RUN_CACHED) out += r.source;
+    uint32_t length = static_cast<uint32_t>(out.size() - header - sizeof(uint32_t));
+    std::memcpy(&out[header], &length, sizeof(length));
+}
+
+inline Eval_request decode_request(const char* p, const char* end) {
+    Eval_request r;
+    r.id = get<uint32_t>(p, end);
+    r.kind = static_cast<Request_kind>(get<uint8_t>(p, end));
+    r.program_id = get<uint64_t>(p, end);
+    uint32_t count = get<uint32_t>(p, end);
+    if (count > static_cast<size_t>(end - p) / sizeof(double)) throw std::runtime_error("Truncated frame.");
+    r.inputs.resize(count);
+    for (auto& d : r.inputs) d = get<double>(p, end);
+    if (r.kind != Request_kind::RUN_CACHED) r.source.assign(p, end);
+    return r;
+}
+
+inline void encode_response(std::string& out, const Eval_response& r) {
+    put(out, static_cast<uint32_t>(sizeof(uint32_t) + 1 + sizeof(uint64_t) + r.output.size()));
+    put(out, r.id);
+    put(out, static_cast<uint8_t>(r.status));
+    put(out, r.program_id);
+    out += r.output;
+}
+
+inline Eval_response decode_response(const char* p, const char* end) {
+    Eval_response r;
+    r.id = get<uint32_t>(p, end);
+    r.status = static_cast<Response_status>(get<uint8_t>(p, end));
+    r.program_id = get<uint64_t>(p, end);
+    r.output.assign(p, end);
+    return r;
+}
+
+inline sockaddr_un address(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw std::runtime_error("Socket path too long: " + path);
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+} // namespace wire
+
+class Eval_server {
+public:
+    using Handler = std::function<Eval_response(const Eval_request&)>;
+
+    // At least two evaluators by default, so that one slow program never
+    // holds every thread even on a single core.
+    Eval_server(std::string socket_path, Handler handler, unsigned threads = std::max(2u, std::thread::hardware_concurrency()))
+        : m_path(std::move(socket_path)), m_handler(std::move(handler)), m_threads(std::max(1u, threads)) {}
+
+    ~Eval_server() {
+        stop_evaluators();
+        for (auto& [id, conn] : m_connections) ::close(conn.fd);
+        if (m_wake >= 0) ::close(m_wake);
+        if (m_epoll >= 0) ::close(m_epoll);
+        if (m_listener >= 0) {
+            ::close(m_listener);
+            ::unlink(m_path.c_str());
+        }
+    }
+
+    // Serves until stop() is called (e.g. from a signal handler).
+    void run() {
+        open_listener();
+        for (unsigned i = 0; i < m_threads; i++) m_evaluators.emplace_back([this] { evaluate_loop(); });
+        std::vector<epoll_event> events(256);
+        std::vector<Pending> batch;
+        while (!m_stopping.load()) {
+            int n = ::epoll_wait(m_epoll, events.data(), static_cast<int>(events.size()), 500);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("epoll_wait: ") + std::strerror(errno));
+            }
+            for (int i = 0; i < n; i++) {
+                uint64_t id = events[i].data.u64;
+                if (id == LISTENER_ID) { accept_all(); continue; }
+                if (id == WAKE_ID) { finish(batch); continue; }
+                auto it = m_connections.find(id);
+                if (it == m_connections.end()) continue;
+                Connection& conn = it->second;
+                if (events[i].events & (EPOLLHUP | EPOLLERR)) { // Gone both ways: nothing can be answered
+                    close_connection(id);
+                    continue;
+                }
+                if ((events[i].events & EPOLLOUT) && !flush(conn)) {
+                    close_connection(id);
+                    continue;
+                }
+                if (!read_requests(conn, batch)) { // Also takes frames held back until output drained
+                    close_connection(id);
+                    continue;
+                }
+                settle(conn);
+            }
+            if (m_accept_paused && std::chrono::steady_clock::now() - m_accept_paused_at > ACCEPT_RETRY) resume_accepting();
+            submit(batch);
+        }
+        stop_evaluators();
+    }
+
+    void stop() { m_stopping.store(true); }
+
+    size_t requests_served() const { return m_served; }
+    unsigned threads() const { return m_threads; }
+
+private:
+    struct Connection {
+        uint64_t id = 0;
+        int fd = -1;
+        std::string in;
+        std::string out;
+        uint32_t in_flight = 0; // Requests read whose responses are not yet queued in `out`
+        bool reading = true;    // False once the peer has shut down its sending side
+        uint32_t events = 0;    // What epoll is watching for
+    };
+    struct Pending {
+        uint64_t connection;
+        Eval_request request;
+        Eval_response response;
+    };
+
+    static constexpr uint64_t LISTENER_ID = 0;
+    static constexpr uint64_t WAKE_ID = UINT64_MAX;
+
+    // How long accepting stays paused for want of descriptors, at most.
+    static constexpr std::chrono::milliseconds ACCEPT_RETRY{100};
+
+    std::string m_path;
+    Handler m_handler;
+    unsigned m_threads;
+    int m_listener = -1;
+    int m_epoll = -1;
+    int m_wake = -1; // eventfd the evaluators write when they have finished a request
+    uint64_t m_next_id = 1;
+    std::unordered_map<uint64_t, Connection> m_connections;
+    std::atomic<bool> m_stopping{false};
+    size_t m_served = 0;
+    bool m_accept_paused = false;
+    std::chrono::steady_clock::time_point m_accept_paused_at;
+
+    // Handed from the epoll thread to the evaluators and back.
+    std::vector<std::thread> m_evaluators;
+    std::mutex m_queue_mutex;
+    std::condition_variable m_queue_ready;
+    std::deque<Pending> m_queued;    // To be evaluated
+    std::vector<Pending> m_finished; // Evaluated, responses not yet queued
+    bool m_evaluators_stopping = false;
+
+    static void fail(const char* what) {
+        throw std::runtime_error(std::string(what) + ": " + std::strerror(errno));
+    }
+
+    void open_listener() {
+        sockaddr_un addr = wire::address(m_path);
+        ::unlink(m_path.c_str());
+        m_listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (m_listener < 0) fail("socket");
+        if (::bind(m_listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) fail("bind");
+        if (::listen(m_listener, SOMAXCONN) < 0) fail("listen");
+        m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+        if (m_epoll < 0) fail("epoll_create1");
+        m_wake = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_wake < 0) fail("eventfd");
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = LISTENER_ID;
+        if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_listener, &ev) < 0) fail("epoll_ctl");
+        ev.data.u64 = WAKE_ID;
+        if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &ev) < 0) fail("epoll_ctl");
+    }
+
+    void accept_all() {
+        while (true) {
+            int fd = ::accept4(m_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                // Out of descriptors or memory: the backlog stays readable, so
+                // epoll would report it again at once.
+                if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) pause_accepting();
+                return; // EAGAIN: drained the backlog
+            }
+            uint64_t id = m_next_id++;
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.u64 = id;
+            if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) < 0) { ::close(fd); continue; }
+            Connection& conn = m_connections[id];
+            conn.id = id;
+            conn.fd = fd;
+            conn.events = ev.events;
+        }
+    }
+
+    void pause_accepting() {
+        epoll_event ev{};
+        ev.data.u64 = LISTENER_ID;
+        ::epoll_ctl(m_epoll, EPOLL_CTL_MOD, m_listener, &ev);
+        m_accept_paused = true;
+        m_accept_paused_at = std::chrono::steady_clock::now();
+    }
+
+    void resume_accepting() {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = LISTENER_ID;
+        ::epoll_ctl(m_epoll, EPOLL_CTL_MOD, m_listener, &ev);
+        m_accept_paused = false;
+    }
+
+    void close_connection(uint64_t id) {
+        auto it = m_connections.find(id);
+        if (it == m_connections.end()) return;
+        ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        ::close(it->second.fd);
+        m_connections.erase(it);
+        if (m_accept_paused) resume_accepting(); // A descriptor is free again
+    }
+
+    // Queues the complete frames in conn.in, as far as MAX_PIPELINED allows.
+    // Returns false on a malformed frame.
+    bool take_frames(Connection& conn, std::vector<Pending>& batch) {
+        size_t pos = 0;
+        try {
+            while (conn.in_flight < MAX_PIPELINED && conn.in.size() - pos >= sizeof(uint32_t)) {
+                uint32_t length;
+                std::memcpy(&length, conn.in.data() + pos, sizeof(length));
+                if (length > MAX_FRAME_SIZE) return false;
+                if (conn.in.size() - pos - sizeof(length) < length) break;
+                const char* payload = conn.in.data() + pos + sizeof(length);
+                batch.push_back({conn.id, wire::decode_request(payload, payload + length), {}});
+                conn.in_flight++;
+                pos += sizeof(length) + length;
+            }
+        } catch (const std::runtime_error&) {
+            return false;
+        }
+        conn.in.erase(0, pos);
+        return true;
+    }
+
+    // Whether to read more from `conn`: its peer may still send, and it has
+    // room for more requests and is keeping up with its responses.
+    static bool wants_input(const Connection& conn) {
+        return conn.reading && conn.in_flight < MAX_PIPELINED && conn.out.empty();
+    }
+
+    // Reads while `conn` wants input, queueing each complete frame. Input
+    // is taken a frame at a time, so conn.in never holds more than one
+    // partial frame and one read beyond it. Returns false when the peer has
+    // gone away or sent something malformed.
+    bool read_requests(Connection& conn, std::vector<Pending>& batch) {
+        char buffer[64 * 1024];
+        while (true) {
+            if (!take_frames(conn, batch)) return false;
+            if (!wants_input(conn)) return true;
+            ssize_t got = ::read(conn.fd, buffer, sizeof(buffer));
+            if (got > 0) { conn.in.append(buffer, static_cast<size_t>(got)); continue; }
+            if (got == 0) { conn.reading = false; continue; } // Answer what came before the shutdown
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            return false;
+        }
+    }
+
+    // Brings what epoll watches `conn` for in line with its state, and
+    // closes it once a half-closed peer has had every answer.
+    void settle(Connection& conn) {
+        if (!conn.reading && conn.in_flight == 0 && conn.out.empty()) {
+            close_connection(conn.id);
+            return;
+        }
+        uint32_t events = (wants_input(conn) ? EPOLLIN | EPOLLRDHUP : 0u) | (conn.out.empty() ? 0u : EPOLLOUT);
+        if (events == conn.events) return;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = conn.id;
+        ::epoll_ctl(m_epoll, EPOLL_CTL_MOD, conn.fd, &ev);
+        conn.events = events;
+    }
+
+    // Hands `batch` to the evaluators, leaving it empty.
+    void submit(std::vector<Pending>& batch) {
+        if (batch.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            std::move(batch.begin(), batch.end(), std::back_inserter(m_queued));
+        }
+        if (batch.size() == 1) m_queue_ready.notify_one();
+        else m_queue_ready.notify_all();
+        batch.clear();
+    }
+
+    // An evaluator thread: runs queued requests one at a time and passes
+    // each back as it finishes.
+    void evaluate_loop() {
+        while (true) {
+            Pending pending;
+            {
+                std::unique_lock<std::mutex> lock(m_queue_mutex);
+                m_queue_ready.wait(lock, [this] { return m_evaluators_stopping || !m_queued.empty(); });
+                if (m_evaluators_stopping) return;
+                pending = std::move(m_queued.front());
+                m_queued.pop_front();
+            }
+            try {
+                pending.response = m_handler(pending.request);
+            } catch (const std::exception& e) {
+                pending.response.status = Response_status::ERROR;
+                pending.response.output = e.what();
+            }
+            pending.response.id = pending.request.id;
+            bool first;
+            {
+                std::lock_guard<std::mutex> lock(m_queue_mutex);
+                first = m_finished.empty();
+                m_finished.push_back(std::move(pending));
+            }
+            uint64_t one = 1;
+            if (first) { // Otherwise the epoll thread has yet to take the earlier ones, and will take this too
+                while (::write(m_wake, &one, sizeof(one)) < 0 && errno == EINTR) {}
+            }
+        }
+    }
+
+    void stop_evaluators() {
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            m_evaluators_stopping = true;
+        }
+        m_queue_ready.notify_all();
+        for (auto& evaluator : m_evaluators) evaluator.join();
+        m_evaluators.clear();
+    }
+
+    // Queues the evaluators' finished responses on their connections and
+    // sends them. Connections that had stopped reading for want of room may
+    // now take more requests, which go into `batch`.
+    void finish(std::vector<Pending>& batch) {
+        uint64_t count;
+        while (::read(m_wake, &count, sizeof(count)) < 0 && errno == EINTR) {}
+        std::vector<Pending> finished;
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            finished.swap(m_finished);
+        }
+        m_served += finished.size();
+
+        // Responses are queued per connection first, so each gets one send.
+        std::vector<uint64_t> touched;
+        for (const auto& pending : finished) {
+            auto it = m_connections.find(pending.connection);
+            if (it == m_connections.end()) continue; // Client left mid-batch
+            if (it->second.out.empty()) touched.push_back(pending.connection);
+            wire::encode_response(it->second.out, pending.response);
+            it->second.in_flight--;
+        }
+        for (uint64_t id : touched) {
+            auto it = m_connections.find(id);
+            if (it == m_connections.end()) continue;
+            Connection& conn = it->second;
+            if (!flush(conn) || !read_requests(conn, batch)) {
+                close_connection(id);
+                continue;
+            }
+            settle(conn);
+        }
+    }
+
+    // Writes as much queued output as the socket takes; settle() then asks
+    // epoll for EPOLLOUT while anything remains. Returns false on a dead
+    // socket.
+    bool flush(Connection& conn) {
+        size_t sent = 0;
+        while (sent < conn.out.size()) {
+            ssize_t n = ::send(conn.fd, conn.out.data() + sent, conn.out.size() - sent, MSG_NOSIGNAL);
+            if (n > 0) { sent += static_cast<size_t>(n); continue; }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return false;
+        }
+        conn.out.erase(0, sent);
+        return true;
+    }
+};
+
+// =======================================================================
+// ==                 CLIENT AND LOAD GENERATOR                         ==
+// =======================================================================
+
+// A blocking client holding one connection to the server.
+class Eval_client {
+public:
+    explicit Eval_client(const std::string& socket_path) {
+        sockaddr_un addr = wire::address(socket_path);
+        m_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (m_fd < 0 || ::connect(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            int err = errno;
+            if (m_fd >= 0) ::close(m_fd);
+            throw std::runtime_error("Cannot connect to " + socket_path + ": " + std::strerror(err));
+        }
+    }
+    ~Eval_client() { ::close(m_fd); }
+    Eval_client(const Eval_client&) = delete;
+    Eval_client& operator=(const Eval_client&) = delete;
+
+    Eval_response call(const Eval_request& request) {
+        std::string frame;
+        wire::encode_request(frame, request);
+        write_all(frame.data(), frame.size());
+
+        uint32_t length;
+        read_all(reinterpret_cast<char*>(&length), sizeof(length));
+        if (length > MAX_FRAME_SIZE) throw std::runtime_error("Response frame too large.");
+        std::string payload(length, '\0');
+        read_all(payload.data(), length);
+        return wire::decode_response(payload.data(), payload.data() + length);
+    }
+
+private:
+    int m_fd;
+
+    void write_all(const char* p, size_t n) {
+        while (n > 0) {
+            ssize_t w = ::send(m_fd, p, n, MSG_NOSIGNAL);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) throw std::runtime_error("Connection lost while sending.");
+            p += w; n -= static_cast<size_t>(w);
+        }
+    }
+    void read_all(char* p, size_t n) {
+        while (n > 0) {
+            ssize_t r = ::read(m_fd, p, n);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) throw std::runtime_error("Connection lost while receiving.");
+            p += r; n -= static_cast<size_t>(r);
+        }
+    }
+};
+
+// Opens `connections` clients, each compiling `source` once and then issuing
+// `requests` RUN_CACHED calls back to back, and prints throughput and latency
+// percentiles for the cached calls.
+inline void run_load_generator(const std::string& socket_path, const std::string& source,
+                               unsigned connections, unsigned requests) {
+    std::vector<std::vector<double>> latencies(connections);
+    std::atomic<unsigned> errors{0};
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned c = 0; c < connections; c++) {
+        threads.emplace_back([&, c] {
+            try {
+                Eval_client client(socket_path);
+                Eval_request request;
+                request.source = source;
+                request.inputs = {static_cast<double>(c)};
+                Eval_response first = client.call(request);
+                if (first.status != Response_status::OK) { errors++; return; }
+
+                request.kind = Request_kind::RUN_CACHED;
+                request.program_id = first.program_id;
+                request.source.clear();
+                latencies[c].reserve(requests);
+                for (unsigned i = 0; i < requests; i++) {
+                    request.id = i;
+                    request.inputs[0] = static_cast<double>(i);
+                    auto t0 = std::chrono::steady_clock::now();
+                    Eval_response response = client.call(request);
+                    auto t1 = std::chrono::steady_clock::now();
+                    if (response.status != Response_status::OK) errors++;
+                    latencies[c].push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+                }
+            } catch (const std::exception& e) {
+                std::fprintf(stderr, "connection %u: %s\n", c, e.what());
+                errors++;
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::vector<double> all;
+    for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) {
+        return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))];
+    };
+    std::printf("requests: %zu  errors: %u  time: %.3f s  throughput: %.0f req/s\n",
+                all.size(), errors.load(), seconds, all.size() / seconds);
+    std::printf("latency us  p50: %.1f  p90: %.1f  p99: %.1f  p99.9: %.1f  max: %.1f\n",
+                percentile(0.50), percentile(0.90), percentile(0.99), percentile(0.999),
+                all.empty() ? 0.0 : all.back());
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+// =======================================================================
+// ==            NATIVE FUNCTION INTERFACE (Host Bindings)              ==
+// =======================================================================
+// Lets SimPL scripts call C++ functions. A function is bound once by its
+// address; a template generates a thunk that unpacks the interpreter's
+// argument array straight into the real call, so no per-call lookup,
+// boxing or std::function indirection is left:
+//
+//     double clamp01(double x) { return x < 0 ? 0 : (x > 1 ? 1 : x); }
+//     Native_registry natives;
+//     natives.bind<clamp01>("clamp01");
+//
+// The parser resolves every call expression to the Native_function it names,
+// so the interpreter only ever does `fn->thunk(args)`.
+
+// Upper bound on arguments, so the interpreter can evaluate them into a stack array.
+constexpr int MAX_NATIVE_ARGS = 8;
+
+// Every bound function is called through this single signature.
+using Native_thunk = double (*)(const double* args);
+
+struct Native_function {
+    std::string name;
+    int arity;
+    Native_thunk thunk;
+};
+
+// A script's number as a parameter of type T. Converting a double that is
+// NaN, infinite or out of range to an integer type is undefined, so integer
+// parameters take only whole numbers in their range and anything else is a
+// runtime error.
+template <typename T>
+T native_argument(double value) {
+    if constexpr (std::is_floating_point_v<T>) {
+        return static_cast<T>(value);
+    } else {
+        // T holds every whole number in [lowest, limit) exactly when it is in range.
+        const double limit = std::ldexp(1.0, std::numeric_limits<T>::digits);
+        const double lowest = std::is_signed_v<T> ? -limit : 0.0;
+        if (!(value >= lowest && value < limit) || value != std::trunc(value)) {
+            throw std::runtime_error("Native function argument must be a whole number in range.");
+        }
+        return static_cast<T>(value);
+    }
+}
+
+// Generates the argument-unpacking thunk for a function pointer known at compile time.
+template <auto Fn, typename Signature = decltype(Fn)>
+struct Native_thunk_for;
+
+template <auto Fn, typename R, typename... Args>
+struct Native_thunk_for<Fn, R (*)(Args...)> {
+    static_assert(sizeof...(Args) <= MAX_NATIVE_ARGS, "Too many parameters for a SimPL native function.");
+    static_assert((std::is_arithmetic_v<Args> && ...), "Native function parameters must be arithmetic.");
+    static_assert(std::is_void_v<R> || std::is_arithmetic_v<R>, "Native function must return void or an arithmetic type.");
+
+    static constexpr int arity = sizeof...(Args);
+
+    static double call(const double* args) {
+        return invoke(args, std::index_sequence_for<Args...>{});
+    }
+
+private:
+    template <std::size_t... I>
+    static double invoke([[maybe_unused]] const double* args, std::index_sequence<I...>) {
+        if constexpr (std::is_void_v<R>) {
+            Fn(native_argument<Args>(args[I])...);
+            return 0.0;
+        } else {
+            return static_cast<double>(Fn(native_argument<Args>(args[I])...));
+        }
+    }
+};
+
+class Native_registry {
+public:
+    // Binds a C++ function under a SimPL name. Rebinding a name binds it to a
+    // new entry: calls parsed before keep the function (and arity) they were
+    // checked against, and only later parses see the new one.
+    template <auto Fn>
+    void bind(const std::string& name) {
+        using Thunk = Native_thunk_for<Fn>;
+        bind_thunk(name, Thunk::arity, &Thunk::call);
+    }
+
+    // Lower-level form for callers that already have a thunk.
+    void bind_thunk(const std::string& name, int arity, Native_thunk thunk) {
+        m_entries.push_back({name, arity, thunk});
+        m_functions[name] = &m_entries.back();
+    }
+
+    // Returns nullptr when nothing is bound under `name`. The pointer stays
+    // valid for the registry's lifetime, even if the name is rebound.
+    const Native_function* find(std::string_view name) const {
+        auto it = m_functions.find(std::string(name));
+        return it == m_functions.end() ? nullptr : it->second;
+    }
+
+private:
+    std::deque<Native_function> m_entries; // Never erased; a deque never moves them
+    std::unordered_map<std::string, const Native_function*> m_functions;
+};
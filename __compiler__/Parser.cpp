@@ -2,10 +2,41 @@
 #include <vector>
 #include <string>
 #include <string_view>
-#include <cctype>
 #include <stdexcept>
 #include <memory>
 #include <unordered_map>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <csignal>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <unordered_set>
+#include <set>
+#include <list>
+#include <charconv>
+
+#include "Native_functions.hpp"
+#include "Simd_kernels.hpp"
+#include "Thread_pool.hpp"
+#include "Eval_server.hpp"
+#include "Program_registry.hpp"
+#include "Batch_loader.hpp"
+#include "Script_bundle.hpp"
+#include "Source_lines.hpp"
+#include "String_literal.hpp"
+#include "Utf8.hpp"
+#ifdef SIMPL_FUZZ
+#include "Perf_fuzzer.hpp"
+#endif
+#include "String_heap.hpp"
+#include "Snapshot_file.hpp"
+#if __cplusplus >= 202002L
+#include "Static_expr.hpp" // For its compile-time checks; it needs C++20
+#endif
 
 // =======================================================================
 // ==               PART 1: LEXER (The Tokenizer)                       ==
@@ -15,8 +46,8 @@
 
 enum class TokenType {
     // Single-character tokens
-    OPEN_PAREN, CLOSE_PAREN, OPEN_BRACE, CLOSE_BRACE,
-    SEMICOLON, PLUS, MINUS, STAR, SLASH,
+    OPEN_PAREN, CLOSE_PAREN, OPEN_BRACE, CLOSE_BRACE, OPEN_BRACKET, CLOSE_BRACKET,
+    SEMICOLON, COMMA, PLUS, MINUS, STAR, SLASH,
 
     // One or two character tokens
     EQUAL, EQUAL_EQUAL, BANG, BANG_EQUAL,
@@ -26,7 +57,7 @@ enum class TokenType {
     IDENTIFIER, STRING, NUMBER,
 
     // Keywords
-    IF, ELSE, PRINT, LET,
+    IF, ELSE, PRINT, LET, FOR, PARALLEL, REDUCE,
 
     // Misc
     END_OF_FILE, UNKNOWN
@@ -35,18 +66,30 @@ enum class TokenType {
 struct Token {
     TokenType type;
     std::string literal;
-    int line = 0;
+    uint32_t offset = 0; // Byte offset of the first character; see Source_lines
 };
 
-// A very simple lexer function.
+// A very simple lexer function. Throws std::runtime_error if the source is
+// not valid UTF-8 or has a malformed string literal; other stray characters
+// become UNKNOWN tokens. Identifiers may contain non-ASCII letters (see
+// is_identifier_code_point).
 std::vector<Token> tokenize(std::string_view source) {
     std::vector<Token> tokens;
     size_t current = 0;
-    int line = 1;
+    std::string scratch; // Decoded strings with escapes, reused
+
+    // Checked once up front, so the loop below can treat every byte >= 0x80
+    // as part of a well-formed character.
+    size_t invalid = utf8_first_invalid(source);
+    if (invalid != source.size()) {
+        throw std::runtime_error("[line " + Source_lines(source).describe(static_cast<uint32_t>(invalid)) +
+                                 "] Error: Invalid UTF-8.");
+    }
 
     std::unordered_map<std::string, TokenType> keywords = {
         {"if", TokenType::IF}, {"else", TokenType::ELSE},
-        {"print", TokenType::PRINT}, {"let", TokenType::LET}
+        {"print", TokenType::PRINT}, {"let", TokenType::LET},
+        {"for", TokenType::FOR}, {"parallel", TokenType::PARALLEL}, {"reduce", TokenType::REDUCE}
     };
 
     while (current < source.length()) {
@@ -54,42 +97,110 @@ std::vector<Token> tokenize(std::string_view source) {
         size_t start = current;
 
         auto make_token = [&](TokenType type) {
-            tokens.push_back({type, std::string(source.substr(start, current - start)), line});
+            tokens.push_back({type, std::string(source.substr(start, current - start)), static_cast<uint32_t>(start)});
         };
         auto match = [&](char expected) {
-            if (current + 1 >= source.length() || source[current + 1] != expected) return false;
+            if (current >= source.length() || source[current] != expected) return false;
             current++; return true;
         };
         current++;
         switch (c) {
-            case ' ': case '\r': case '\t': break;
-            case '\n': line++; break;
+            case ' ': case '\r': case '\t': case '\n': break;
             case '(': make_token(TokenType::OPEN_PAREN); break;
             case ')': make_token(TokenType::CLOSE_PAREN); break;
             case '{': make_token(TokenType::OPEN_BRACE); break;
             case '}': make_token(TokenType::CLOSE_BRACE); break;
+            case '[': make_token(TokenType::OPEN_BRACKET); break;
+            case ']': make_token(TokenType::CLOSE_BRACKET); break;
             case ';': make_token(TokenType::SEMICOLON); break;
+            case ',': make_token(TokenType::COMMA); break;
             case '+': make_token(TokenType::PLUS); break;
             case '-': make_token(TokenType::MINUS); break;
             case '*': make_token(TokenType::STAR); break;
-            case '/': make_token(TokenType::SLASH); break;
+            case '/':
+                if (current < source.length() && source[current] == '/') { // Comment runs to end of line
+                    while (current < source.length() && source[current] != '\n') current++;
+                } else { make_token(TokenType::SLASH); }
+                break;
             case '=': make_token(match('=') ? TokenType::EQUAL_EQUAL : TokenType::EQUAL); break;
             case '!': make_token(match('=') ? TokenType::BANG_EQUAL : TokenType::BANG); break;
             case '<': make_token(match('=') ? TokenType::LESS_EQUAL : TokenType::LESS); break;
             case '>': make_token(match('=') ? TokenType::GREATER_EQUAL : TokenType::GREATER); break;
+            case '"': {
+                String_scan scan = scan_string_literal(source, start, scratch);
+                if (scan.error) {
+                    throw std::runtime_error("[line " + Source_lines(source).describe(static_cast<uint32_t>(start)) +
+                                             "] Error: " + scan.error);
+                }
+                tokens.push_back({TokenType::STRING, std::string(scan.value), static_cast<uint32_t>(start)});
+                current = scan.end;
+                break;
+            }
             default:
-                if (std::isdigit(c)) {
-                    while (current < source.length() && std::isdigit(source[current])) current++;
+                if (is_ascii_digit(c)) {
+                    while (current < source.length() && is_ascii_digit(source[current])) current++;
                     make_token(TokenType::NUMBER);
-                } else if (std::isalpha(c) || c == '_') {
-                    while (current < source.length() && (std::isalnum(source[current]) || source[current] == '_')) current++;
+                } else if (size_t length = identifier_char_length(source, start, true)) {
+                    current = start + length;
+                    while (current < source.length() && (length = identifier_char_length(source, current, false))) {
+                        current += length;
+                    }
                     std::string text = std::string(source.substr(start, current - start));
                     make_token(keywords.count(text) ? keywords.at(text) : TokenType::IDENTIFIER);
-                } else { make_token(TokenType::UNKNOWN); }
+                } else {
+                    if (static_cast<unsigned char>(c) >= 0x80) current = start + utf8_sequence_length(source, start); // The whole character
+                    make_token(TokenType::UNKNOWN);
+                }
                 break;
         }
     }
-    tokens.push_back({TokenType::END_OF_FILE, "", line});
+    tokens.push_back({TokenType::END_OF_FILE, "", static_cast<uint32_t>(source.length())});
+    return tokens;
+}
+
+// --- Pre-lexed token streams (stored in script bundles) ---
+// Each token is: u8 type | u32 offset | u32 length | literal bytes. The format
+// id changes whenever TokenType does, and its version (the high half) is
+// bumped whenever tokenize() makes different tokens of the same source, so
+// stale streams are detected. 3: string literals are lexed; 4: UTF-8
+// identifiers; 5: only non-ASCII letters in identifiers.
+constexpr uint32_t TOKEN_STREAM_FORMAT = (5u << 16) | (static_cast<uint32_t>(TokenType::UNKNOWN) + 1);
+
+std::string encode_tokens(const std::vector<Token>& tokens) {
+    std::string out;
+    for (const Token& token : tokens) {
+        uint8_t type = static_cast<uint8_t>(token.type);
+        uint32_t length = static_cast<uint32_t>(token.literal.size());
+        out.append(reinterpret_cast<const char*>(&type), sizeof(type));
+        out.append(reinterpret_cast<const char*>(&token.offset), sizeof(token.offset));
+        out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        out += token.literal;
+    }
+    return out;
+}
+
+std::vector<Token> decode_tokens(std::string_view stream) {
+    std::vector<Token> tokens;
+    size_t pos = 0;
+    auto read_u32 = [&](uint32_t& value) {
+        if (stream.size() - pos < sizeof(value)) throw std::runtime_error("Corrupt token stream.");
+        std::memcpy(&value, stream.data() + pos, sizeof(value));
+        pos += sizeof(value);
+    };
+    while (pos < stream.size()) {
+        uint8_t type = static_cast<uint8_t>(stream[pos++]);
+        uint32_t offset, length;
+        read_u32(offset);
+        read_u32(length);
+        if (type > static_cast<uint8_t>(TokenType::UNKNOWN) || stream.size() - pos < length) {
+            throw std::runtime_error("Corrupt token stream.");
+        }
+        tokens.push_back({static_cast<TokenType>(type), std::string(stream.substr(pos, length)), offset});
+        pos += length;
+    }
+    if (tokens.empty() || tokens.back().type != TokenType::END_OF_FILE) {
+        throw std::runtime_error("Corrupt token stream.");
+    }
     return tokens;
 }
 
@@ -103,8 +214,36 @@ std::vector<Token> tokenize(std::string_view source) {
 // Forward-declarations are needed because the structs can refer to each other.
 struct Stmt; struct Expr;
 
+// Variables live in numbered slots instead of a map keyed by name. The parser
+// gives each distinct name a slot as it goes, and the interpreter just indexes
+// an array. A table can outlive one parse (the REPL keeps adding to it).
+class Slot_table {
+public:
+    int resolve(const std::string& name) {
+        auto [it, inserted] = m_slots.try_emplace(name, static_cast<int>(m_names.size()));
+        if (inserted) m_names.push_back(name);
+        return it->second;
+    }
+
+    // -1 if no code has referenced `name`.
+    int find(const std::string& name) const {
+        auto it = m_slots.find(name);
+        return it == m_slots.end() ? -1 : it->second;
+    }
+
+    const std::string& name(int slot) const { return m_names[slot]; }
+    size_t size() const { return m_names.size(); }
+
+private:
+    std::unordered_map<std::string, int> m_slots;
+    std::vector<std::string> m_names;
+};
+
 // Base struct for all statements (actions like `let`, `print`, `if`)
-struct Stmt { virtual ~Stmt() = default; };
+struct Stmt {
+    uint32_t offset = 0; // Where the statement starts in the source
+    virtual ~Stmt() = default;
+};
 
 // Base struct for all expressions (things that produce a value like `5`, `x + 2`)
 struct Expr { virtual ~Expr() = default; };
@@ -116,6 +255,12 @@ struct BinaryExpr : Expr {
     std::unique_ptr<Expr> right;
     BinaryExpr(std::unique_ptr<Expr> l, Token o, std::unique_ptr<Expr> r)
         : left(std::move(l)), op(o), right(std::move(r)) {}
+    // A chain like "a + b + c" leans left as deep as it is long, so it is
+    // freed down its left side in a loop rather than by recursion.
+    ~BinaryExpr() override {
+        std::unique_ptr<Expr> next = std::move(left);
+        while (auto* chained = dynamic_cast<BinaryExpr*>(next.get())) next = std::move(chained->left);
+    }
 };
 
 // An AST node for a literal value like a number
@@ -127,14 +272,45 @@ struct LiteralExpr : Expr {
 // An AST node for a variable name being used in an expression
 struct VariableExpr : Expr {
     Token name;
-    explicit VariableExpr(Token n) : name(n) {}
+    int slot;
+    VariableExpr(Token n, int s) : name(n), slot(s) {}
 };
 
 // An AST node for an assignment like "x = 10"
 struct AssignExpr : Expr {
     Token name;
+    int slot;
     std::unique_ptr<Expr> value;
-    AssignExpr(Token n, std::unique_ptr<Expr> val) : name(n), value(std::move(val)) {}
+    AssignExpr(Token n, int s, std::unique_ptr<Expr> val) : name(n), slot(s), value(std::move(val)) {}
+};
+
+// Array functions the interpreter implements itself rather than through a native binding.
+enum class Builtin { NONE, LEN, SUM, MIN, MAX };
+
+// An AST node for a call to a host function, e.g., "sqrt(x)"
+struct CallExpr : Expr {
+    Token callee;
+    std::vector<std::unique_ptr<Expr>> arguments;
+    const Native_function* native; // Resolved by the parser, never looked up again
+    Builtin builtin;               // Set instead of `native` for len/sum/min/max(array)
+    CallExpr(Token c, std::vector<std::unique_ptr<Expr>> args, const Native_function* fn, Builtin b = Builtin::NONE)
+        : callee(c), arguments(std::move(args)), native(fn), builtin(b) {}
+};
+
+// An AST node for an array literal, e.g., "[1, 2, 3]"
+struct ArrayExpr : Expr {
+    Token bracket;
+    std::vector<std::unique_ptr<Expr>> elements;
+    ArrayExpr(Token b, std::vector<std::unique_ptr<Expr>> elems) : bracket(b), elements(std::move(elems)) {}
+};
+
+// An AST node for indexing into an array, e.g., "a[i]"
+struct IndexExpr : Expr {
+    std::unique_ptr<Expr> object;
+    Token bracket;
+    std::unique_ptr<Expr> index;
+    IndexExpr(std::unique_ptr<Expr> o, Token b, std::unique_ptr<Expr> i)
+        : object(std::move(o)), bracket(b), index(std::move(i)) {}
 };
 
 // An AST node for a statement that is just an expression, e.g., "5 + 10;"
@@ -152,8 +328,9 @@ struct PrintStmt : Stmt {
 // An AST node for a `let` declaration, e.g., "let x = 10;"
 struct LetStmt : Stmt {
     Token name;
+    int slot;
     std::unique_ptr<Expr> initializer; // Can be empty if just "let x;"
-    LetStmt(Token n, std::unique_ptr<Expr> init) : name(n), initializer(std::move(init)) {}
+    LetStmt(Token n, int s, std::unique_ptr<Expr> init) : name(n), slot(s), initializer(std::move(init)) {}
 };
 
 // An AST node for a block of statements inside { ... }
@@ -171,6 +348,51 @@ struct IfStmt : Stmt {
         : condition(std::move(c)), thenBranch(std::move(t)), elseBranch(std::move(e)) {}
 };
 
+// One "reduce(op name)" clause of a parallel for loop.
+struct Reduction {
+    Token op;   // +, *, or the identifier min / max
+    Token name;
+    int slot;
+};
+
+// An AST node for a counted loop, e.g., "for (i = 0, n) ..." runs i = 0, 1, ..., n - 1.
+// With `parallel`, iterations may run concurrently; the parser has checked that
+// they only write their own locals and the declared reduction variables.
+struct ForStmt : Stmt {
+    Token variable;
+    int slot;
+    std::unique_ptr<Expr> start;
+    std::unique_ptr<Expr> end;
+    std::unique_ptr<Stmt> body;
+    bool parallel;
+    std::vector<Reduction> reductions;
+    ForStmt(Token v, int slot_, std::unique_ptr<Expr> s, std::unique_ptr<Expr> e, std::unique_ptr<Stmt> b,
+            bool p, std::vector<Reduction> r)
+        : variable(v), slot(slot_), start(std::move(s)), end(std::move(e)), body(std::move(b)),
+          parallel(p), reductions(std::move(r)) {}
+};
+
+// Never produced by the parser. A debugger swaps one in for a statement it
+// needs to see (see Debugger) and takes it out again when done, so statements
+// nobody is watching run exactly as if no debugger existed.
+class Interpreter;
+struct Statement_hooks {
+    virtual ~Statement_hooks() = default;
+    virtual void before(const Stmt& target, Interpreter& interpreter) = 0;
+    virtual void after(const Stmt& target, Interpreter& interpreter) = 0;
+    // Called instead of after() when `target` threw.
+    virtual void abandon(const Stmt& target) = 0;
+};
+
+struct HookStmt : Stmt {
+    std::unique_ptr<Stmt> inner;
+    const Stmt* target;     // inner.get(); stays valid when the debugger hands `inner` back
+    Statement_hooks* hooks;
+    HookStmt(std::unique_ptr<Stmt> i, Statement_hooks* h) : inner(std::move(i)), target(inner.get()), hooks(h) {
+        offset = target->offset;
+    }
+};
+
 
 // =======================================================================
 // ==         PART 3: PARSER (The Syntax Analyzer)                      ==
@@ -181,7 +403,12 @@ struct IfStmt : Stmt {
 class Parser {
 public:
     // Constructor: Initializes the parser with the token stream from the lexer.
-    explicit Parser(const std::vector<Token>& tokens) : m_tokens(tokens) {}
+    // Calls are resolved against `natives` (without it, any call is an error)
+    // and variable names against `slots`, which gains any new names. Errors
+    // give line:column when `lines` maps the tokens' source, else byte offsets.
+    Parser(const std::vector<Token>& tokens, const Native_registry* natives, Slot_table& slots,
+           const Source_lines* lines = nullptr)
+        : m_tokens(tokens), m_natives(natives), m_slots(slots), m_lines(lines) {}
 
     // The main entry point. It parses a list of statements until it hits the end of the file.
     std::vector<std::unique_ptr<Stmt>> parse() {
@@ -194,8 +421,44 @@ public:
 
 private:
     const std::vector<Token>& m_tokens;
+    const Native_registry* m_natives;
+    Slot_table& m_slots;
+    const Source_lines* m_lines;
     size_t m_current = 0;
 
+    // Statements and expressions nest at most this deep (parentheses, blocks,
+    // nested statements, assignments, indexing), so walking the tree later
+    // cannot overflow the stack however the input is shaped. A chain of binary
+    // operators like "a + b + c" does not count: it is parsed in a loop, and
+    // everything that walks the tree follows its left side in a loop too.
+    static constexpr int MAX_NESTING = 1000;
+    int m_nesting = 0;
+
+    class Nesting_guard {
+    public:
+        explicit Nesting_guard(Parser& parser) : m_parser(parser) {}
+        ~Nesting_guard() { m_parser.m_nesting -= m_levels; }
+        Nesting_guard(const Nesting_guard&) = delete;
+        Nesting_guard& operator=(const Nesting_guard&) = delete;
+
+        void enter(const Token& at) {
+            m_levels++;
+            if (++m_parser.m_nesting > MAX_NESTING) {
+                throw std::runtime_error(m_parser.where(at) + " Error: Too deeply nested.");
+            }
+        }
+
+    private:
+        Parser& m_parser;
+        int m_levels = 0;
+    };
+
+    // Where `token` is, for error messages.
+    std::string where(const Token& token) const {
+        if (m_lines) return "[line " + m_lines->describe(token.offset) + "]";
+        return "[offset " + std::to_string(token.offset) + "]";
+    }
+
     // --- Helper functions to manage the token stream ---
     Token peek() const { return m_tokens[m_current]; }
     Token previous() const { return m_tokens[m_current - 1]; }
@@ -217,14 +480,16 @@ private:
     // Checks if the current token has a specific type. If not, it's a syntax error.
     Token consume(TokenType type, const std::string& message) {
         if (check(type)) return advance();
-        throw std::runtime_error("[line " + std::to_string(peek().line) + "] Error: " + message);
+        throw std::runtime_error(where(peek()) + " Error: " + message);
     }
 
     // --- Parsing for Statements (Actions) ---
     // A program is a list of declarations.
     std::unique_ptr<Stmt> declaration() {
-        if (match({TokenType::LET})) return let_declaration();
-        return statement();
+        uint32_t offset = peek().offset;
+        auto stmt = match({TokenType::LET}) ? let_declaration() : statement();
+        stmt->offset = offset;
+        return stmt;
     }
     
     // Parses a 'let' statement.
@@ -235,12 +500,27 @@ private:
             initializer = expression();
         }
         consume(TokenType::SEMICOLON, "Expect ';' after variable declaration.");
-        return std::make_unique<LetStmt>(name, std::move(initializer));
+        return std::make_unique<LetStmt>(name, m_slots.resolve(name.literal), std::move(initializer));
     }
     
-    // The main router for all other kinds of statements.
+    // Records where each statement starts, for breakpoints.
     std::unique_ptr<Stmt> statement() {
+        uint32_t offset = peek().offset;
+        auto stmt = statement_at();
+        stmt->offset = offset;
+        return stmt;
+    }
+
+    // The main router for all other kinds of statements.
+    std::unique_ptr<Stmt> statement_at() {
+        Nesting_guard nesting(*this);
+        nesting.enter(peek());
         if (match({TokenType::IF})) return if_statement();
+        if (match({TokenType::FOR})) return for_statement(false);
+        if (match({TokenType::PARALLEL})) {
+            consume(TokenType::FOR, "Expect 'for' after 'parallel'.");
+            return for_statement(true);
+        }
         if (match({TokenType::PRINT})) return print_statement();
         if (match({TokenType::OPEN_BRACE})) return std::make_unique<BlockStmt>(block());
         return expression_statement();
@@ -259,6 +539,205 @@ private:
         return std::make_unique<IfStmt>(std::move(condition), std::move(thenBranch), std::move(elseBranch));
     }
     
+    // Parses "for (i = start, end) body", optionally followed (when parallel)
+    // by "reduce(+ a, * b, min c, max d)" before the body.
+    std::unique_ptr<Stmt> for_statement(bool parallel) {
+        consume(TokenType::OPEN_PAREN, "Expect '(' after 'for'.");
+        Token variable = consume(TokenType::IDENTIFIER, "Expect loop variable name.");
+        consume(TokenType::EQUAL, "Expect '=' after loop variable.");
+        auto start = expression();
+        consume(TokenType::COMMA, "Expect ',' between loop start and end.");
+        auto end = expression();
+        consume(TokenType::CLOSE_PAREN, "Expect ')' after loop range.");
+
+        std::vector<Reduction> reductions;
+        if (match({TokenType::REDUCE})) {
+            if (!parallel) {
+                throw std::runtime_error(where(previous()) + " Error: 'reduce' is only allowed on a parallel for.");
+            }
+            consume(TokenType::OPEN_PAREN, "Expect '(' after 'reduce'.");
+            do {
+                Token op = peek();
+                bool is_min_max = op.type == TokenType::IDENTIFIER && (op.literal == "min" || op.literal == "max");
+                if (op.type != TokenType::PLUS && op.type != TokenType::STAR && !is_min_max) {
+                    throw std::runtime_error(where(op) + " Error: Expect reduction operator '+', '*', 'min' or 'max'.");
+                }
+                advance();
+                Token name = consume(TokenType::IDENTIFIER, "Expect reduction variable name.");
+                reductions.push_back({op, name, m_slots.resolve(name.literal)});
+            } while (match({TokenType::COMMA}));
+            consume(TokenType::CLOSE_PAREN, "Expect ')' after reductions.");
+        }
+
+        auto body = statement();
+        if (parallel) {
+            Parallel_checker(*this, variable, reductions).check_body(body.get());
+        }
+        return std::make_unique<ForStmt>(variable, m_slots.resolve(variable.literal), std::move(start), std::move(end), std::move(body),
+                                         parallel, std::move(reductions));
+    }
+
+    // Proves a parallel loop body has no cross-iteration dependencies: it may
+    // read anything, but may only write variables it declares itself (those are
+    // private to the iteration) and reduction variables, and the latter only
+    // in the form "s = s + expr" (or *, or "m = min(m, expr)") with `expr` not
+    // reading the accumulator. Printing is rejected since its order would vary.
+    // A variable the body declares may be read only after its `let` on every
+    // path: before that it still holds what an earlier iteration left there.
+    // So a `let` inside an if branch or a nested loop's body (which may not
+    // run) counts only within it, as does the nested loop's counter.
+    class Parallel_checker {
+    public:
+        Parallel_checker(const Parser& parser, const Token& loop_var, const std::vector<Reduction>& reductions)
+            : m_parser(parser), m_loop_var(loop_var) {
+            for (const auto& r : reductions) {
+                if (r.name.literal == loop_var.literal || m_reductions.count(r.name.literal)) {
+                    fail(r.name, "'" + r.name.literal + "' cannot be reduced here.");
+                }
+                m_reductions[r.name.literal] = r.op;
+            }
+        }
+
+        void check_body(const Stmt* body) {
+            find_declarations(body);
+            check(body);
+        }
+
+    private:
+        const Parser& m_parser;
+        Token m_loop_var;
+        std::unordered_map<std::string, Token> m_reductions;
+        std::unordered_set<std::string> m_private;  // Declared on every path to this point
+        std::unordered_set<std::string> m_declared; // Declared anywhere in the body
+
+        [[noreturn]] void fail(const Token& at, const std::string& message) const {
+            throw std::runtime_error(m_parser.where(at) + " Error: " + message);
+        }
+
+        void find_declarations(const Stmt* stmt) {
+            if (auto* s = dynamic_cast<const LetStmt*>(stmt)) { m_declared.insert(s->name.literal); }
+            else if (auto* s = dynamic_cast<const BlockStmt*>(stmt)) {
+                for (const auto& st : s->statements) find_declarations(st.get());
+            }
+            else if (auto* s = dynamic_cast<const IfStmt*>(stmt)) {
+                find_declarations(s->thenBranch.get());
+                if (s->elseBranch) find_declarations(s->elseBranch.get());
+            }
+            else if (auto* s = dynamic_cast<const ForStmt*>(stmt)) {
+                m_declared.insert(s->variable.literal);
+                find_declarations(s->body.get());
+            }
+        }
+
+        // Checks `stmt`, which may run or not, keeping what it declares to itself.
+        void check_maybe(const Stmt* stmt) {
+            auto declared = m_private;
+            check(stmt);
+            m_private = std::move(declared);
+        }
+
+        void check(const Stmt* stmt) {
+            if (auto* s = dynamic_cast<const ExpressionStmt*>(stmt)) { check(s->expression.get()); }
+            else if (auto* s = dynamic_cast<const PrintStmt*>(stmt)) {
+                (void)s;
+                fail(m_loop_var, "'print' is not allowed inside a parallel for.");
+            }
+            else if (auto* s = dynamic_cast<const LetStmt*>(stmt)) {
+                if (s->initializer) check(s->initializer.get());
+                declare(s->name);
+            }
+            else if (auto* s = dynamic_cast<const BlockStmt*>(stmt)) {
+                for (const auto& st : s->statements) check(st.get());
+            }
+            else if (auto* s = dynamic_cast<const IfStmt*>(stmt)) {
+                check(s->condition.get());
+                check_maybe(s->thenBranch.get());
+                if (s->elseBranch) check_maybe(s->elseBranch.get());
+            }
+            else if (auto* s = dynamic_cast<const ForStmt*>(stmt)) {
+                check(s->start.get());
+                check(s->end.get());
+                auto declared = m_private;
+                declare(s->variable); // A nested loop's counter is fresh every iteration it runs
+                check(s->body.get());
+                m_private = std::move(declared);
+            }
+        }
+
+        void declare(const Token& name) {
+            if (name.literal == m_loop_var.literal || m_reductions.count(name.literal)) {
+                fail(name, "Cannot redeclare '" + name.literal + "' inside a parallel for.");
+            }
+            m_private.insert(name.literal);
+        }
+
+        void check(const Expr* expr) {
+            if (auto* e = dynamic_cast<const VariableExpr*>(expr)) {
+                if (m_reductions.count(e->name.literal)) {
+                    fail(e->name, "Reduction variable '" + e->name.literal + "' can only be read by its own update.");
+                }
+                if (m_declared.count(e->name.literal) && !m_private.count(e->name.literal)) {
+                    fail(e->name, "Parallel for reads '" + e->name.literal + "' where the body may not have set it yet, so it can hold another iteration's value.");
+                }
+            }
+            else if (auto* e = dynamic_cast<const AssignExpr*>(expr)) {
+                auto reduction = m_reductions.find(e->name.literal);
+                if (reduction != m_reductions.end()) {
+                    check(reduction_operand(e, reduction->second));
+                } else if (e->name.literal == m_loop_var.literal) {
+                    fail(e->name, "Cannot assign to loop variable '" + e->name.literal + "'.");
+                } else if (!m_private.count(e->name.literal)) {
+                    fail(e->name, "Parallel for writes to '" + e->name.literal + "', which is shared across iterations.");
+                } else {
+                    check(e->value.get());
+                }
+            }
+            else if (auto* e = dynamic_cast<const BinaryExpr*>(expr)) {
+                // Down a chain's left side in a loop; see MAX_NESTING
+                for (; e; e = dynamic_cast<const BinaryExpr*>(expr)) {
+                    check(e->right.get());
+                    expr = e->left.get();
+                }
+                check(expr);
+            }
+            else if (auto* e = dynamic_cast<const CallExpr*>(expr)) {
+                for (const auto& arg : e->arguments) check(arg.get());
+            }
+            else if (auto* e = dynamic_cast<const ArrayExpr*>(expr)) {
+                for (const auto& element : e->elements) check(element.get());
+            }
+            else if (auto* e = dynamic_cast<const IndexExpr*>(expr)) {
+                check(e->object.get());
+                check(e->index.get());
+            }
+        }
+
+        // Matches "s = s op operand" / "s = min(s, operand)" and returns the operand.
+        const Expr* reduction_operand(const AssignExpr* assign, const Token& op) {
+            const std::string& name = assign->name.literal;
+            auto is_accumulator = [&](const std::unique_ptr<Expr>& e) {
+                auto* var = dynamic_cast<const VariableExpr*>(e.get());
+                return var && var->name.literal == name;
+            };
+            if (op.type == TokenType::IDENTIFIER) {
+                auto* call = dynamic_cast<const CallExpr*>(assign->value.get());
+                if (call && call->callee.literal == op.literal && call->arguments.size() == 2) {
+                    if (is_accumulator(call->arguments[0])) return call->arguments[1].get();
+                    if (is_accumulator(call->arguments[1])) return call->arguments[0].get();
+                }
+            } else {
+                auto* binary = dynamic_cast<const BinaryExpr*>(assign->value.get());
+                if (binary && binary->op.type == op.type) {
+                    if (is_accumulator(binary->left)) return binary->right.get();
+                    if (is_accumulator(binary->right)) return binary->left.get();
+                }
+            }
+            std::string form = op.type == TokenType::IDENTIFIER ? name + " = " + op.literal + "(" + name + ", ...)"
+                                                                : name + " = " + name + " " + op.literal + " ...";
+            fail(assign->name, "Reduction variable '" + name + "' must be updated as '" + form + "'.");
+        }
+    };
+
     // Parses a block of statements.
     std::vector<std::unique_ptr<Stmt>> block() {
         std::vector<std::unique_ptr<Stmt>> statements;
@@ -289,6 +768,8 @@ private:
 
     // Precedence Level 0: Expression (Entry Point)
     std::unique_ptr<Expr> expression() {
+        Nesting_guard nesting(*this);
+        nesting.enter(peek());
         return assignment();
     }
     
@@ -297,11 +778,13 @@ private:
         auto expr = equality();
         if (match({TokenType::EQUAL})) {
             Token equals = previous();
+            Nesting_guard nesting(*this);
+            nesting.enter(equals);
             auto value = assignment(); // Assignment is right-associative
             if (auto* var = dynamic_cast<VariableExpr*>(expr.get())) {
-                return std::make_unique<AssignExpr>(var->name, std::move(value));
+                return std::make_unique<AssignExpr>(var->name, var->slot, std::move(value));
             }
-            throw std::runtime_error("[line " + std::to_string(equals.line) + "] Error: Invalid assignment target.");
+            throw std::runtime_error(where(equals) + " Error: Invalid assignment target.");
         }
         return expr;
     }
@@ -341,24 +824,86 @@ private:
     
     // Precedence Level 5: Factor (*, /)
     std::unique_ptr<Expr> factor() {
-        auto expr = primary();
+        auto expr = call();
         while (match({TokenType::SLASH, TokenType::STAR})) {
             Token op = previous();
-            auto right = primary();
+            auto right = call();
             expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
         }
         return expr;
     }
     
-    // Precedence Level 6: Primary (literals, variables, grouping with parentheses)
+    // Precedence Level 6: Call and index, e.g. "f(a, b)" or "a[i][j]". Only plain names can be called.
+    std::unique_ptr<Expr> call() {
+        auto expr = primary();
+        if (check(TokenType::OPEN_PAREN)) {
+            auto* var = dynamic_cast<VariableExpr*>(expr.get());
+            if (!var) {
+                throw std::runtime_error(where(peek()) + " Error: Can only call functions.");
+            }
+            advance();
+            expr = finish_call(var->name);
+        }
+        Nesting_guard chain(*this);
+        while (match({TokenType::OPEN_BRACKET})) {
+            Token bracket = previous();
+            chain.enter(bracket);
+            auto index = expression();
+            consume(TokenType::CLOSE_BRACKET, "Expect ']' after index.");
+            expr = std::make_unique<IndexExpr>(std::move(expr), bracket, std::move(index));
+        }
+        return expr;
+    }
+
+    // Parses the argument list and binds the call to its native function right away.
+    std::unique_ptr<Expr> finish_call(const Token& callee) {
+        std::vector<std::unique_ptr<Expr>> arguments;
+        if (!check(TokenType::CLOSE_PAREN)) {
+            do {
+                arguments.push_back(expression());
+            } while (match({TokenType::COMMA}));
+        }
+        consume(TokenType::CLOSE_PAREN, "Expect ')' after arguments.");
+
+        // Single-argument len/sum/min/max work on arrays and take priority over natives.
+        if (arguments.size() == 1) {
+            static const std::unordered_map<std::string, Builtin> builtins = {
+                {"len", Builtin::LEN}, {"sum", Builtin::SUM}, {"min", Builtin::MIN}, {"max", Builtin::MAX}
+            };
+            auto it = builtins.find(callee.literal);
+            if (it != builtins.end()) {
+                return std::make_unique<CallExpr>(callee, std::move(arguments), nullptr, it->second);
+            }
+        }
+
+        const Native_function* fn = m_natives ? m_natives->find(callee.literal) : nullptr;
+        if (!fn) {
+            throw std::runtime_error(where(callee) + " Error: Undefined function '" + callee.literal + "'.");
+        }
+        if (static_cast<int>(arguments.size()) != fn->arity) {
+            throw std::runtime_error(where(callee) + " Error: '" + callee.literal + "' expects " +
+                                     std::to_string(fn->arity) + " arguments but got " + std::to_string(arguments.size()) + ".");
+        }
+        return std::make_unique<CallExpr>(callee, std::move(arguments), fn);
+    }
+
+    // Precedence Level 7: Primary (literals, variables, grouping with parentheses)
     // This is the "base case" of the expression recursion.
     std::unique_ptr<Expr> primary() {
-        if (match({TokenType::NUMBER, TokenType::STRING})) {
+        if (match({TokenType::NUMBER})) {
+            // Only digits, so the one way it can be bad is too large for a double.
+            if (!std::isfinite(std::strtod(previous().literal.c_str(), nullptr))) {
+                throw std::runtime_error(where(previous()) + " Error: Number literal too large.");
+            }
+            return std::make_unique<LiteralExpr>(previous());
+        }
+
+        if (match({TokenType::STRING})) {
             return std::make_unique<LiteralExpr>(previous());
         }
 
         if (match({TokenType::IDENTIFIER})) {
-            return std::make_unique<VariableExpr>(previous());
+            return std::make_unique<VariableExpr>(previous(), m_slots.resolve(previous().literal));
         }
 
         if (match({TokenType::OPEN_PAREN})) {
@@ -367,7 +912,19 @@ private:
             return expr;
         }
 
-        throw std::runtime_error("[line " + std::to_string(peek().line) + "] Error: Expect expression.");
+        if (match({TokenType::OPEN_BRACKET})) {
+            Token bracket = previous();
+            std::vector<std::unique_ptr<Expr>> elements;
+            if (!check(TokenType::CLOSE_BRACKET)) {
+                do {
+                    elements.push_back(expression());
+                } while (match({TokenType::COMMA}));
+            }
+            consume(TokenType::CLOSE_BRACKET, "Expect ']' after array elements.");
+            return std::make_unique<ArrayExpr>(bracket, std::move(elements));
+        }
+
+        throw std::runtime_error(where(peek()) + " Error: Expect expression.");
     }
 };
 
@@ -378,35 +935,154 @@ private:
 // This class "walks" the AST produced by the parser and executes the code.
 // This is what makes our language actually do something!
 
+// A runtime value: a plain number, a reference to an immutable array of
+// numbers, or a string. Arrays are shared rather than copied on assignment;
+// element-wise operators always produce a new array. Strings are handles into
+// the interpreter's String_heap, so only the interpreter can print them.
+enum class ValueType { NUMBER, ARRAY, STRING, UNDEFINED };
+
+struct Value {
+    ValueType type = ValueType::NUMBER;
+    double number = 0.0;
+    std::shared_ptr<const std::vector<double>> array;
+    String_heap::Handle string = String_heap::EMPTY;
+
+    static Value of(double n) { Value v; v.number = n; return v; }
+    static Value of(std::vector<double> elements) {
+        Value v;
+        v.type = ValueType::ARRAY;
+        v.array = std::make_shared<const std::vector<double>>(std::move(elements));
+        return v;
+    }
+    static Value of_string(String_heap::Handle h) { Value v; v.type = ValueType::STRING; v.string = h; return v; }
+    // Only ever stored in a slot whose `let` has not run yet.
+    static Value undefined() { Value v; v.type = ValueType::UNDEFINED; return v; }
+    bool is_array() const { return type == ValueType::ARRAY; }
+    bool is_string() const { return type == ValueType::STRING; }
+    bool is_defined() const { return type != ValueType::UNDEFINED; }
+};
+
 class Interpreter {
 public:
-    void interpret(const std::vector<std::unique_ptr<Stmt>>& statements) {
+    // Variables are stored by the slots in `slots`; `print` output goes to
+    // `out` and runtime errors to `err`. Values persist across interpret() calls.
+    explicit Interpreter(const Slot_table& slots, std::ostream& out = std::cout, std::ostream& err = std::cerr)
+        : m_slot_table(slots), m_out(out), m_err(err), m_strings(std::make_shared<String_heap>()) {}
+
+    // Returns false if the program stopped on a runtime error. `statements`
+    // is any sequence of (smart) pointers to Stmt.
+    template <typename Statements>
+    bool interpret(const Statements& statements) {
+        m_values.resize(m_slot_table.size(), Value::undefined()); // Room for names parsed since last time
         try {
             for (const auto& statement : statements) {
-                execute(statement.get());
+                execute(&*statement);
+            }
+        } catch (const std::exception& e) {
+            m_err << "Runtime Error: " << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Creates or overwrites a variable before running, e.g. to pass in inputs.
+    // Names the program never mentions have no slot and are ignored.
+    void define(const std::string& name, Value value) {
+        int slot = m_slot_table.find(name);
+        if (slot < 0) return;
+        if (m_values.size() <= static_cast<size_t>(slot)) m_values.resize(m_slot_table.size(), Value::undefined());
+        m_values[slot] = std::move(value);
+    }
+
+    // The current value of every slot, undefined ones included.
+    const std::vector<Value>& values() const { return m_values; }
+
+    // Caps the loop iterations the program may still run, after which it
+    // stops with a runtime error. Unlimited by default.
+    void set_iteration_limit(uint64_t limit) { m_iterations_left = limit; }
+
+    // Prints `value` the way `print` does.
+    void write(std::ostream& out, const Value& value) const {
+        if (value.is_string()) {
+            m_strings->write(out, value.string);
+        } else if (value.is_array()) {
+            out << "[";
+            for (size_t i = 0; i < value.array->size(); i++) {
+                out << (i ? ", " : "") << (*value.array)[i];
             }
-        } catch (const std::runtime_error& e) {
-            std::cerr << "Runtime Error: " << e.what() << std::endl;
+            out << "]";
+        } else {
+            out << value.number;
         }
     }
 
+    String_heap& strings() { return *m_strings; }
+    const String_heap& strings() const { return *m_strings; }
+
 private:
-    // A map to store our variables. This is our program's "memory".
-    std::unordered_map<std::string, double> environment;
+    const Slot_table& m_slot_table;
+    std::ostream& m_out;
+    std::ostream& m_err;
+
+    // Our program's "memory": one entry per slot in m_slot_table.
+    std::vector<Value> m_values;
+    uint64_t m_iterations_left = std::numeric_limits<uint64_t>::max();
+
+    // Shared with the workers of a parallel loop. Only the interpreter that
+    // owns the slots collects it, between statements: at that point every
+    // live string is held by a slot, so m_values is the complete root set.
+    std::shared_ptr<String_heap> m_strings;
+    bool m_worker = false;
+
+    // In a parallel loop's worker, what is left of the limit, shared by all
+    // the workers; m_iterations_left is then only what this worker has
+    // drawn from it and not yet spent.
+    std::atomic<uint64_t>* m_budget = nullptr;
+
+    // Iterations a worker draws from the shared budget beyond what it needs,
+    // so that it goes back to it about once per this many.
+    static constexpr uint64_t BUDGET_DRAW = 1024;
+
+    // Charges `count` loop iterations against the limit.
+    void spend_iterations(double count) {
+        if (count > static_cast<double>(m_iterations_left) && !draw_iterations(count)) {
+            throw std::runtime_error("Iteration limit exceeded.");
+        }
+        m_iterations_left -= static_cast<uint64_t>(count);
+    }
+
+    // Tops a worker's iterations up from the shared budget to at least
+    // `count`; false if the budget does not have that many.
+    bool draw_iterations(double count) {
+        if (!m_budget) return false;
+        uint64_t need = static_cast<uint64_t>(count) - m_iterations_left;
+        uint64_t left = m_budget->load(std::memory_order_relaxed);
+        for (;;) {
+            if (need > left) return false;
+            uint64_t take = std::min(left, need + BUDGET_DRAW);
+            if (m_budget->compare_exchange_weak(left, left - take, std::memory_order_relaxed)) {
+                m_iterations_left += take;
+                return true;
+            }
+        }
+    }
 
     // Main dispatcher for statements. It checks the type of statement and calls the right handler.
     void execute(const Stmt* stmt) {
+        if (!m_worker && m_strings->collection_due()) collect_strings();
+
         if (auto* s = dynamic_cast<const ExpressionStmt*>(stmt)) { evaluate(s->expression.get()); }
         else if (auto* s = dynamic_cast<const PrintStmt*>(stmt)) {
-            double value = evaluate(s->expression.get());
-            std::cout << value << std::endl;
+            Value value = evaluate(s->expression.get());
+            write(m_out, value);
+            m_out << std::endl;
         }
         else if (auto* s = dynamic_cast<const LetStmt*>(stmt)) {
-            double value = 0.0;
+            Value value;
             if (s->initializer) {
                 value = evaluate(s->initializer.get());
             }
-            environment[s->name.literal] = value;
+            m_values[s->slot] = std::move(value);
         }
         else if (auto* s = dynamic_cast<const BlockStmt*>(stmt)) {
             for(const auto& st : s->statements) {
@@ -414,80 +1090,1605 @@ private:
             }
         }
         else if (auto* s = dynamic_cast<const IfStmt*>(stmt)) {
-            double condition = evaluate(s->condition.get());
+            double condition = as_number(evaluate(s->condition.get()), "Condition");
             if (condition != 0) { // In our simple language, 0 is false, everything else is true
                 execute(s->thenBranch.get());
             } else if (s->elseBranch) {
                 execute(s->elseBranch.get());
             }
         }
+        else if (auto* s = dynamic_cast<const ForStmt*>(stmt)) {
+            execute_for(s);
+        }
+        else if (auto* s = dynamic_cast<const HookStmt*>(stmt)) { // Last, so unhooked statements never test for it
+            const Stmt* target = s->target; // The hook may unpatch `s` while it runs
+            Statement_hooks* hooks = s->hooks;
+            hooks->before(*target, *this);
+            // Pairs before() with abandon() if `target` throws
+            struct Abandon_on_throw {
+                Statement_hooks* hooks;
+                const Stmt* target;
+                ~Abandon_on_throw() { if (hooks) hooks->abandon(*target); }
+            } abandon_on_throw{hooks, target};
+            execute(target);
+            abandon_on_throw.hooks = nullptr;
+            hooks->after(*target, *this);
+        }
+    }
+
+    void collect_strings() {
+        std::vector<String_heap::Handle> roots;
+        for (const Value& value : m_values) {
+            if (value.is_string()) roots.push_back(value.string);
+        }
+        m_strings->collect(roots);
+    }
+
+    // Most iterations one loop may run: up to here every value of the loop
+    // variable is a distinct double, and the count fits a size_t.
+    static constexpr double MAX_LOOP_ITERATIONS = 9007199254740992.0; // 2^53
+
+    void execute_for(const ForStmt* s) {
+        double start = as_number(evaluate(s->start.get()), "Loop start");
+        double end = as_number(evaluate(s->end.get()), "Loop end");
+        if (!std::isfinite(start) || !std::isfinite(end)) {
+            throw std::runtime_error("Loop bounds must be finite.");
+        }
+        if (end > start && std::ceil(end - start) > MAX_LOOP_ITERATIONS) {
+            throw std::runtime_error("Loop runs too many iterations.");
+        }
+        if (s->parallel) {
+            execute_parallel_for(s, start, end);
+            return;
+        }
+        for (double i = start; i < end; i++) {
+            spend_iterations(1);
+            m_values[s->slot] = Value::of(i);
+            execute(s->body.get());
+        }
+    }
+
+    // Upper bound on chunks per parallel loop. It depends only on the trip count,
+    // never on the thread count, so reductions combine in the same order everywhere.
+    static constexpr size_t PARALLEL_CHUNKS = 256;
+
+    // Each chunk runs on a private copy of the slots with every reduction
+    // variable reset to its identity; the partial results are then folded into
+    // the real variables in chunk order. Everything else the body writes is
+    // iteration-local and discarded.
+    void execute_parallel_for(const ForStmt* s, double start, double end) {
+        spend_iterations(end > start ? std::ceil(end - start) : 0);
+        size_t count = end > start ? static_cast<size_t>(std::ceil(end - start)) : 0;
+        for (const auto& r : s->reductions) {
+            as_number(defined(r.slot, r.name), "Reduction variable '" + r.name.literal + "'");
+        }
+        if (count == 0) return;
+
+        size_t chunk_size = (count + PARALLEL_CHUNKS - 1) / PARALLEL_CHUNKS;
+        size_t chunks = (count + chunk_size - 1) / chunk_size;
+        std::vector<std::vector<double>> partials(chunks, std::vector<double>(s->reductions.size()));
+
+        // Loops nested in the body all draw on what is left of the limit.
+        std::atomic<uint64_t> budget(m_budget ? 0 : m_iterations_left);
+        std::atomic<uint64_t>* shared_budget = m_budget ? m_budget : &budget;
+
+        Thread_pool::shared().run_chunks(chunks, [&](size_t chunk) {
+            Interpreter worker(m_slot_table, m_out, m_err);
+            worker.m_strings = m_strings;
+            worker.m_worker = true;
+            worker.m_values = m_values;
+            worker.m_iterations_left = 0;
+            worker.m_budget = shared_budget;
+            for (const auto& r : s->reductions) {
+                worker.m_values[r.slot] = Value::of(reduction_identity(r.op));
+            }
+            size_t last = std::min(count, (chunk + 1) * chunk_size);
+            for (size_t k = chunk * chunk_size; k < last; k++) {
+                worker.m_values[s->slot] = Value::of(start + static_cast<double>(k));
+                worker.execute(s->body.get());
+            }
+            for (size_t j = 0; j < s->reductions.size(); j++) {
+                const Reduction& r = s->reductions[j];
+                partials[chunk][j] = as_number(worker.m_values[r.slot], "Reduction variable '" + r.name.literal + "'");
+            }
+            shared_budget->fetch_add(worker.m_iterations_left, std::memory_order_relaxed); // Drawn but not spent
+        });
+        if (!m_budget) m_iterations_left = budget.load(std::memory_order_relaxed);
+
+        for (size_t j = 0; j < s->reductions.size(); j++) {
+            double& total = m_values[s->reductions[j].slot].number;
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                total = reduction_combine(s->reductions[j].op, total, partials[chunk][j]);
+            }
+        }
+    }
+
+    static double reduction_identity(const Token& op) {
+        if (op.type == TokenType::PLUS) return 0.0;
+        if (op.type == TokenType::STAR) return 1.0;
+        return op.literal == "min" ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+    }
+
+    static double reduction_combine(const Token& op, double a, double b) {
+        if (op.type == TokenType::PLUS) return a + b;
+        if (op.type == TokenType::STAR) return a * b;
+        return op.literal == "min" ? std::min(a, b) : std::max(a, b);
     }
     
     // Main dispatcher for expressions. It evaluates an expression and returns its value.
-    double evaluate(const Expr* expr) {
+    Value evaluate(const Expr* expr) {
         if (auto* e = dynamic_cast<const LiteralExpr*>(expr)) {
-            return std::stod(e->value.literal);
+            if (e->value.type == TokenType::STRING) return Value::of_string(m_strings->literal(e->value.literal));
+            return Value::of(std::stod(e->value.literal));
         }
         if (auto* e = dynamic_cast<const VariableExpr*>(expr)) {
-            if (environment.count(e->name.literal)) {
-                return environment.at(e->name.literal);
-            }
-            throw std::runtime_error("Undefined variable '" + e->name.literal + "'.");
+            return defined(e->slot, e->name);
         }
         if (auto* e = dynamic_cast<const AssignExpr*>(expr)) {
-            double value = evaluate(e->value.get());
-            if (environment.count(e->name.literal)) {
-                environment[e->name.literal] = value;
-                return value;
-            }
-            throw std::runtime_error("Undefined variable '" + e->name.literal + "'.");
-        }
-        if (auto* e = dynamic_cast<const BinaryExpr*>(expr)) {
-            double left = evaluate(e->left.get());
-            double right = evaluate(e->right.get());
-            switch (e->op.type) {
-                case TokenType::PLUS:          return left + right;
-                case TokenType::MINUS:         return left - right;
-                case TokenType::STAR:          return left * right;
-                case TokenType::SLASH:         return left / right;
-                case TokenType::GREATER:       return left > right;
-                case TokenType::GREATER_EQUAL: return left >= right;
-                case TokenType::LESS:          return left < right;
-                case TokenType::LESS_EQUAL:    return left <= right;
-                case TokenType::EQUAL_EQUAL:   return left == right;
-                case TokenType::BANG_EQUAL:    return left != right;
-                default: break;
+            Value value = evaluate(e->value.get());
+            defined(e->slot, e->name) = value;
+            return value;
+        }
+        if (auto* e = dynamic_cast<const CallExpr*>(expr)) {
+            if (e->builtin != Builtin::NONE) {
+                return call_builtin(e);
+            }
+            double args[MAX_NATIVE_ARGS];
+            for (size_t i = 0; i < e->arguments.size(); i++) {
+                args[i] = as_number(evaluate(e->arguments[i].get()), "Argument to '" + e->callee.literal + "'");
+            }
+            return Value::of(e->native->thunk(args));
+        }
+        if (auto* e = dynamic_cast<const ArrayExpr*>(expr)) {
+            std::vector<double> elements;
+            elements.reserve(e->elements.size());
+            for (const auto& element : e->elements) {
+                elements.push_back(as_number(evaluate(element.get()), "Array element"));
+            }
+            return Value::of(std::move(elements));
+        }
+        if (auto* e = dynamic_cast<const IndexExpr*>(expr)) {
+            Value object = evaluate(e->object.get());
+            if (object.is_string()) {
+                double index = as_number(evaluate(e->index.get()), "String index");
+                uint64_t at = checked_index(index, m_strings->length(object.string), "String");
+                return Value::of_string(m_strings->byte_at(object.string, at));
+            }
+            double index = as_number(evaluate(e->index.get()), "Array index");
+            if (!object.is_array()) {
+                throw std::runtime_error("Only arrays and strings can be indexed.");
             }
+            return Value::of((*object.array)[checked_index(index, object.array->size(), "Array")]);
         }
-        return 0.0; // Should not be reached
+        if (auto* e = dynamic_cast<const BinaryExpr*>(expr)) return evaluate_chain(e);
+        return Value(); // Should not be reached
     }
-};
 
+    // A chain like "a + b + c" is a tree leaning left as deep as the chain is
+    // long: it is walked down its left side in a loop, and then each operator
+    // applied on the way back up, left to right as written.
+    Value evaluate_chain(const BinaryExpr* top) {
+        static constexpr size_t FEW = 16;
+        const BinaryExpr* few[FEW];
+        std::vector<const BinaryExpr*> many; // Only for a chain longer than FEW
+        size_t length = 0;
+        const Expr* first = top;
+        for (const BinaryExpr* e; (e = dynamic_cast<const BinaryExpr*>(first)); first = e->left.get()) {
+            if (length < FEW) few[length] = e;
+            else {
+                if (many.empty()) many.assign(few, few + FEW);
+                many.push_back(e);
+            }
+            length++;
+        }
+        Value value = evaluate(first);
+        for (size_t i = length; i-- > 0;) {
+            const BinaryExpr* e = length <= FEW ? few[i] : many[i];
+            value = binary(e->op, value, evaluate(e->right.get()));
+        }
+        return value;
+    }
 
-// =======================================================================
-// ==                    PART 5: MAIN DRIVER                            ==
-// =======================================================================
-// This function puts all the pieces together.
+    Value binary(const Token& op, const Value& left, const Value& right) {
+        if (left.is_string() || right.is_string()) {
+            return string_binary(op, left, right);
+        }
+        if (left.is_array() || right.is_array()) {
+            return array_binary(op, left, right);
+        }
+        double l = left.number;
+        double r = right.number;
+        switch (op.type) {
+            case TokenType::PLUS:          return Value::of(l + r);
+            case TokenType::MINUS:         return Value::of(l - r);
+            case TokenType::STAR:          return Value::of(l * r);
+            case TokenType::SLASH:         return Value::of(l / r);
+            case TokenType::GREATER:       return Value::of(l > r);
+            case TokenType::GREATER_EQUAL: return Value::of(l >= r);
+            case TokenType::LESS:          return Value::of(l < r);
+            case TokenType::LESS_EQUAL:    return Value::of(l <= r);
+            case TokenType::EQUAL_EQUAL:   return Value::of(l == r);
+            case TokenType::BANG_EQUAL:    return Value::of(l != r);
+            default: break;
+        }
+        return Value(); // Should not be reached
+    }
 
-int main() {
-    std::string source = R"(
-        let a = 10;
-        let b = 0;
+    // The slot's value, or an error if its `let` has not run yet.
+    Value& defined(int slot, const Token& name) {
+        Value& value = m_values[slot];
+        if (!value.is_defined()) {
+            throw std::runtime_error("Undefined variable '" + name.literal + "'.");
+        }
+        return value;
+    }
 
-        if (a > 5) {
-            b = a * 2 + (a / 5); // b should become 10*2 + 2 = 22
-            print b;
-        } else {
-            print 999; // This part should not run
+    // `index` as a position in something `length` long. NaN fails every
+    // comparison, so the range test only lets valid indexes through.
+    static uint64_t checked_index(double index, uint64_t length, const std::string& what) {
+        if (!(index >= 0 && index < static_cast<double>(length))) {
+            throw std::runtime_error(what + " index out of range.");
+        }
+        if (index != std::floor(index)) {
+            throw std::runtime_error(what + " index must be a whole number.");
         }
+        return static_cast<uint64_t>(index);
+    }
 
-        let c = b - 2; // c should be 22 - 2 = 20
-        print c;
-    )";
+    static double as_number(const Value& value, const std::string& what) {
+        if (value.is_array()) {
+            throw std::runtime_error(what + " must be a number, not an array.");
+        }
+        if (value.is_string()) {
+            throw std::runtime_error(what + " must be a number, not a string.");
+        }
+        return value.number;
+    }
 
-    std::cout << "--- Compiling and Running SimPL Code ---\n";
-    try {
-        // Step 1: Lexing (Source Code -> Tokens)
-        std::vector<Token> tokens = tokenize(source);
+    // '+' concatenates two strings (as a rope: nothing is copied yet); the
+    // comparisons compare bytes. Strings never mix with numbers or arrays.
+    Value string_binary(const Token& op, const Value& left, const Value& right) {
+        if (op.type == TokenType::MINUS || op.type == TokenType::STAR || op.type == TokenType::SLASH) {
+            throw std::runtime_error("Operator '" + op.literal + "' is not supported on strings.");
+        }
+        if (!left.is_string() || !right.is_string()) {
+            throw std::runtime_error("Operator '" + op.literal + "' needs two strings or no strings.");
+        }
+        String_heap& heap = *m_strings;
+        switch (op.type) {
+            case TokenType::PLUS:          return Value::of_string(heap.concat(left.string, right.string));
+            case TokenType::EQUAL_EQUAL:   return Value::of(heap.equal(left.string, right.string));
+            case TokenType::BANG_EQUAL:    return Value::of(!heap.equal(left.string, right.string));
+            case TokenType::GREATER:       return Value::of(heap.compare(left.string, right.string) > 0);
+            case TokenType::GREATER_EQUAL: return Value::of(heap.compare(left.string, right.string) >= 0);
+            case TokenType::LESS:          return Value::of(heap.compare(left.string, right.string) < 0);
+            case TokenType::LESS_EQUAL:    return Value::of(heap.compare(left.string, right.string) <= 0);
+            default: break;
+        }
+        return Value(); // Should not be reached
+    }
+
+    // Element-wise operators. A number on either side is broadcast across the array.
+    static Value array_binary(const Token& op, const Value& left, const Value& right) {
+        Simd_op simd_op;
+        switch (op.type) {
+            case TokenType::PLUS:          simd_op = Simd_op::ADD; break;
+            case TokenType::MINUS:         simd_op = Simd_op::SUB; break;
+            case TokenType::STAR:          simd_op = Simd_op::MUL; break;
+            case TokenType::SLASH:         simd_op = Simd_op::DIV; break;
+            case TokenType::GREATER:       simd_op = Simd_op::GREATER; break;
+            case TokenType::GREATER_EQUAL: simd_op = Simd_op::GREATER_EQUAL; break;
+            case TokenType::LESS:          simd_op = Simd_op::LESS; break;
+            case TokenType::LESS_EQUAL:    simd_op = Simd_op::LESS_EQUAL; break;
+            case TokenType::EQUAL_EQUAL:   simd_op = Simd_op::EQUAL; break;
+            case TokenType::BANG_EQUAL:    simd_op = Simd_op::NOT_EQUAL; break;
+            default: throw std::runtime_error("Operator '" + op.literal + "' is not supported on arrays.");
+        }
+        if (left.is_array() && right.is_array() && left.array->size() != right.array->size()) {
+            throw std::runtime_error("Array length mismatch: " + std::to_string(left.array->size()) +
+                                     " vs " + std::to_string(right.array->size()) + ".");
+        }
+
+        const double* a = left.is_array() ? left.array->data() : &left.number;
+        const double* b = right.is_array() ? right.array->data() : &right.number;
+        size_t n = left.is_array() ? left.array->size() : right.array->size();
+        std::vector<double> result(n);
+        simd_binary(simd_op, a, !left.is_array(), b, !right.is_array(), result.data(), n);
+        return Value::of(std::move(result));
+    }
 
-        // Step 2: Parsing (Tokens ->
\ No newline at end of file
+    Value call_builtin(const CallExpr* e) {
+        Value arg = evaluate(e->arguments[0].get());
+        if (arg.is_string() && e->builtin == Builtin::LEN) {
+            return Value::of(static_cast<double>(m_strings->length(arg.string)));
+        }
+        if (!arg.is_array()) {
+            throw std::runtime_error("'" + e->callee.literal + "' expects an array.");
+        }
+        const std::vector<double>& elements = *arg.array;
+        switch (e->builtin) {
+            case Builtin::LEN: return Value::of(static_cast<double>(elements.size()));
+            case Builtin::SUM: return Value::of(simd_sum(elements.data(), elements.size()));
+            case Builtin::MIN:
+            case Builtin::MAX:
+                if (elements.empty()) {
+                    throw std::runtime_error("'" + e->callee.literal + "' of an empty array.");
+                }
+                return Value::of(e->builtin == Builtin::MIN ? simd_min(elements.data(), elements.size())
+                                                            : simd_max(elements.data(), elements.size()));
+            case Builtin::NONE: break;
+        }
+        return Value(); // Should not be reached
+    }
+};
+
+
+// --- Debugger ---
+// Breakpoints by line, single-stepping and variable watches, without a check
+// on every statement. The debugger finds every statement once, up front, and
+// only the ones it currently needs are wrapped in a HookStmt:
+//
+//   breakpoint  the statements starting on the line
+//   watch       the statements that write the variable themselves
+//   stepping    every statement, until the next "continue"
+//
+// With nothing set, the tree is exactly what the parser built, so a program
+// runs at full speed with the debugger attached ("Parser --debug-bench"
+// measures this). Statements inside a parallel for are never hooked, since
+// their iterations run on other threads.
+//
+// Commands, read from `in` whenever execution pauses:
+//   s(tep)  c(ontinue)  b(reak) <line>  d(elete) <line>  w(atch) <name>
+//   u(nwatch) <name>  p(rint) <name>  vars  q(uit)
+class Debugger : public Statement_hooks {
+public:
+    // `statements` is patched in place; it, `slots` and `lines` must outlive
+    // the debugger, which puts the tree back as it was when destroyed.
+    Debugger(std::vector<std::unique_ptr<Stmt>>& statements, const Slot_table& slots, const Source_lines& lines,
+             std::istream& in, std::ostream& out)
+        : m_slots(slots), m_lines(lines), m_in(in), m_out(out) {
+        for (auto& statement : statements) collect(statement, false);
+    }
+
+    ~Debugger() override {
+        m_breakpoints.clear();
+        m_watches.clear();
+        m_stepping = false;
+        apply();
+    }
+
+    Debugger(const Debugger&) = delete;
+    Debugger& operator=(const Debugger&) = delete;
+
+    void set_breakpoint(uint32_t line, bool on) {
+        if (on) m_breakpoints.insert(line);
+        else m_breakpoints.erase(line);
+        apply();
+    }
+
+    // Returns false if no code uses `name`.
+    bool set_watch(const std::string& name, bool on) {
+        int slot = m_slots.find(name);
+        if (slot < 0) return false;
+        if (on) m_watches.insert(slot);
+        else m_watches.erase(slot);
+        apply();
+        return true;
+    }
+
+    void set_stepping(bool on) {
+        m_stepping = on;
+        apply();
+    }
+
+    // Statements currently wrapped in a hook.
+    size_t hooked() const {
+        size_t count = 0;
+        for (const auto& site : m_sites) count += site.hooked;
+        return count;
+    }
+
+    void before(const Stmt& target, Interpreter& interpreter) override {
+        uint32_t line = m_lines.locate(target.offset).line;
+        bool breakpoint = m_breakpoints.count(line) && !dynamic_cast<const BlockStmt*>(&target);
+        if (m_stepping || breakpoint) {
+            pause(line, m_stepping ? "step" : "breakpoint", interpreter);
+        }
+        std::vector<Watched> watched;
+        for (int slot : m_watches) watched.push_back(snapshot(slot, interpreter));
+        m_watched.push_back(std::move(watched));
+    }
+
+    void after(const Stmt& target, Interpreter& interpreter) override {
+        std::vector<Watched> old = std::move(m_watched.back());
+        m_watched.pop_back();
+        bool changed = false;
+        for (const Watched& before : old) {
+            Watched now = snapshot(before.slot, interpreter);
+            if (m_watches.count(before.slot) && !same(before, now)) {
+                m_out << "watch " << m_slots.name(before.slot) << ": " << describe(before.value, before.text, interpreter)
+                      << " -> " << describe(now.value, now.text, interpreter) << "\n";
+                changed = true;
+            }
+        }
+        if (changed && !m_stepping) pause(m_lines.locate(target.offset).line, "watch", interpreter);
+        release_retired();
+    }
+
+    void abandon(const Stmt&) override {
+        m_watched.pop_back();
+        release_retired();
+    }
+
+private:
+    // A statement and the unique_ptr that owns it (or the hook around it).
+    struct Site {
+        std::unique_ptr<Stmt>* owner;
+        const Stmt* target;
+        uint32_t line;
+        bool in_parallel;
+        bool hooked = false;
+    };
+
+    const Slot_table& m_slots;
+    const Source_lines& m_lines;
+    std::istream& m_in;
+    std::ostream& m_out;
+    std::vector<Site> m_sites;
+    std::unordered_set<uint32_t> m_breakpoints;
+    std::set<int> m_watches;
+    bool m_stepping = false;
+    // A watched variable's value. Strings are kept as text: the statement in
+    // between may collect the string heap and reuse the handle.
+    struct Watched {
+        int slot;
+        Value value;
+        std::string text;
+    };
+    std::vector<std::vector<Watched>> m_watched; // Watched values before each running hook
+    std::vector<std::unique_ptr<Stmt>> m_retired; // Removed hooks; one may still be running
+
+    // A removed hook may be the one whose before() or after() is running, so
+    // it is freed only once no hook is left on the stack. The interpreter
+    // touches nothing in a HookStmt after after() or abandon() returns.
+    void release_retired() {
+        if (m_watched.empty()) m_retired.clear();
+    }
+
+    void collect(std::unique_ptr<Stmt>& owner, bool in_parallel) {
+        Stmt* stmt = owner.get();
+        m_sites.push_back({&owner, stmt, m_lines.locate(stmt->offset).line, in_parallel});
+        if (auto* s = dynamic_cast<BlockStmt*>(stmt)) {
+            for (auto& child : s->statements) collect(child, in_parallel);
+        } else if (auto* s = dynamic_cast<IfStmt*>(stmt)) {
+            collect(s->thenBranch, in_parallel);
+            if (s->elseBranch) collect(s->elseBranch, in_parallel);
+        } else if (auto* s = dynamic_cast<ForStmt*>(stmt)) {
+            collect(s->body, in_parallel || s->parallel);
+        }
+    }
+
+    bool needed(const Site& site) const {
+        if (site.in_parallel) return false;
+        if (m_stepping || m_breakpoints.count(site.line)) return true;
+        for (int slot : m_watches) {
+            if (writes(site.target, slot)) return true;
+        }
+        return false;
+    }
+
+    // Patches hooks in and out until exactly the needed statements have one.
+    void apply() {
+        for (auto& site : m_sites) {
+            bool want = needed(site);
+            if (want == site.hooked) continue;
+            if (want) {
+                *site.owner = std::make_unique<HookStmt>(std::move(*site.owner), this);
+            } else {
+                std::unique_ptr<Stmt> inner = std::move(static_cast<HookStmt*>(site.owner->get())->inner);
+                m_retired.push_back(std::move(*site.owner));
+                *site.owner = std::move(inner);
+            }
+            site.hooked = want;
+        }
+    }
+
+    // Whether `stmt` itself (not a nested statement) assigns `slot`.
+    static bool writes(const Stmt* stmt, int slot) {
+        if (auto* s = dynamic_cast<const LetStmt*>(stmt)) return s->slot == slot || assigns(s->initializer.get(), slot);
+        if (auto* s = dynamic_cast<const ExpressionStmt*>(stmt)) return assigns(s->expression.get(), slot);
+        if (auto* s = dynamic_cast<const PrintStmt*>(stmt)) return assigns(s->expression.get(), slot);
+        if (auto* s = dynamic_cast<const IfStmt*>(stmt)) return assigns(s->condition.get(), slot);
+        if (auto* s = dynamic_cast<const ForStmt*>(stmt)) {
+            if (s->slot == slot || assigns(s->start.get(), slot) || assigns(s->end.get(), slot)) return true;
+            for (const auto& r : s->reductions) {
+                if (r.slot == slot) return true;
+            }
+        }
+        return false;
+    }
+
+    static bool assigns(const Expr* expr, int slot) {
+        if (!expr) return false;
+        for (auto* e = dynamic_cast<const BinaryExpr*>(expr); e; e = dynamic_cast<const BinaryExpr*>(expr)) {
+            if (assigns(e->right.get(), slot)) return true; // Down a chain's left side in a loop
+            expr = e->left.get();
+        }
+        if (auto* e = dynamic_cast<const AssignExpr*>(expr)) return e->slot == slot || assigns(e->value.get(), slot);
+        if (auto* e = dynamic_cast<const IndexExpr*>(expr)) return assigns(e->object.get(), slot) || assigns(e->index.get(), slot);
+        if (auto* e = dynamic_cast<const CallExpr*>(expr)) {
+            for (const auto& a : e->arguments) if (assigns(a.get(), slot)) return true;
+        }
+        if (auto* e = dynamic_cast<const ArrayExpr*>(expr)) {
+            for (const auto& a : e->elements) if (assigns(a.get(), slot)) return true;
+        }
+        return false;
+    }
+
+    static Value value_of(int slot, const Interpreter& interpreter);
+
+    static Watched snapshot(int slot, const Interpreter& interpreter) {
+        Value value = value_of(slot, interpreter);
+        std::string text = value.is_string() ? interpreter.strings().to_string(value.string) : std::string();
+        return {slot, std::move(value), std::move(text)};
+    }
+
+    static bool same(const Watched& a, const Watched& b) {
+        if (a.value.type != b.value.type) return false;
+        if (a.value.is_string()) return a.text == b.text;
+        if (a.value.is_array()) return a.value.array == b.value.array || *a.value.array == *b.value.array;
+        return a.value.number == b.value.number || (std::isnan(a.value.number) && std::isnan(b.value.number));
+    }
+
+    // `text` stands in for a string value's contents, if given.
+    static std::string describe(const Value& value, const std::string& text, const Interpreter& interpreter) {
+        if (!value.is_defined()) return "(undefined)";
+        if (value.is_string()) return '"' + text + '"';
+        std::ostringstream out;
+        interpreter.write(out, value);
+        return out.str();
+    }
+
+    static std::string describe(const Value& value, const Interpreter& interpreter) {
+        std::string text = value.is_string() ? interpreter.strings().to_string(value.string) : std::string();
+        return describe(value, text, interpreter);
+    }
+
+    // `text` as a line of the script, or 0 if it is not one (so the command
+    // falls through to the usage line).
+    uint32_t line_number(const std::string& text) const {
+        uint32_t line = 0;
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), line);
+        if (error != std::errc() || end != text.data() + text.size() || line > m_lines.line_count()) return 0;
+        return line;
+    }
+
+    void pause(uint32_t line, const char* why, Interpreter& interpreter) {
+        m_out << "[line " << line << "] " << why << ": " << m_lines.line_text(line) << "\n";
+        std::string command;
+        while (m_out << "(debug) " << std::flush, std::getline(m_in, command)) {
+            std::istringstream words(command);
+            std::string verb, arg;
+            words >> verb >> arg;
+            uint32_t line_arg = 0;
+            if (verb == "s" || verb == "step") { set_stepping(true); return; }
+            if (verb == "c" || verb == "continue") { set_stepping(false); return; }
+            if (verb == "q" || verb == "quit") throw std::runtime_error("Stopped by the debugger.");
+            if ((verb == "b" || verb == "break" || verb == "d" || verb == "delete") && (line_arg = line_number(arg))) {
+                set_breakpoint(line_arg, verb[0] == 'b');
+            } else if ((verb == "w" || verb == "watch" || verb == "u" || verb == "unwatch") && !arg.empty()) {
+                if (!set_watch(arg, verb[0] == 'w')) m_out << "No variable '" << arg << "'.\n";
+            } else if ((verb == "p" || verb == "print") && !arg.empty()) {
+                int slot = m_slots.find(arg);
+                if (slot < 0) m_out << "No variable '" << arg << "'.\n";
+                else m_out << arg << " = " << describe(value_of(slot, interpreter), interpreter) << "\n";
+            } else if (verb == "vars") {
+                for (size_t i = 0; i < m_slots.size(); i++) {
+                    Value value = value_of(static_cast<int>(i), interpreter);
+                    if (value.is_defined()) m_out << m_slots.name(static_cast<int>(i)) << " = " << describe(value, interpreter) << "\n";
+                }
+            } else if (!verb.empty()) {
+                m_out << "Commands: step, continue, break <line>, delete <line>, watch <name>, unwatch <name>,"
+                      << " print <name>, vars, quit\n";
+            }
+        }
+        set_stepping(false); // End of input: run to completion
+        m_breakpoints.clear();
+        m_watches.clear();
+        apply();
+    }
+};
+
+Value Debugger::value_of(int slot, const Interpreter& interpreter) {
+    const std::vector<Value>& values = interpreter.values();
+    return static_cast<size_t>(slot) < values.size() ? values[slot] : Value::undefined();
+}
+
+// =======================================================================
+// ==                    PART 5: MAIN DRIVER                            ==
+// =======================================================================
+// This function puts all the pieces together.
+
+// Host functions made available to scripts.
+double host_sqrt(double x) { return std::sqrt(x); }
+double host_max(double a, double b) { return a > b ? a : b; }
+double host_min(double a, double b) { return a < b ? a : b; }
+
+void register_host_functions(Native_registry& natives) {
+    natives.bind<host_sqrt>("sqrt");
+    natives.bind<host_max>("max");
+    natives.bind<host_min>("min");
+}
+
+// A parsed program. The AST owns copies of its tokens, so the source text and
+// token vector can be dropped once parsing is done.
+struct Program {
+    Slot_table slots;
+    std::vector<std::unique_ptr<Stmt>> statements;
+};
+
+// `lines`, if given, maps the tokens' source so errors can give line:column.
+std::unique_ptr<Program> compile_tokens(const std::vector<Token>& tokens, const Native_registry& natives,
+                                        const Source_lines* lines = nullptr) {
+    auto program = std::make_unique<Program>();
+    Parser parser(tokens, &natives, program->slots, lines);
+    program->statements = parser.parse();
+    return program;
+}
+
+std::unique_ptr<Program> compile_program(std::string_view source, const Native_registry& natives) {
+    Source_lines lines(source);
+    return compile_tokens(tokenize(source), natives, &lines);
+}
+
+// --- Incremental compilation ---
+// Recompiling a large script after a small edit should only parse what was
+// edited. The token stream is split into top-level statements, and each one
+// is fingerprinted by its token types and literals (not its line numbers, so
+// inserting a line above does not invalidate it). Statements whose tokens
+// match one from the previous build reuse its parsed AST as is.
+//
+// A parsed statement depends on nothing but its own tokens: the slot table is
+// shared by every build and only ever grows, so reused statements keep valid
+// slots, and calls were resolved against the same native registry. Changed
+// statements are therefore the only ones that need parsing again.
+//
+// Builds share the slot table and ASTs, so a compiler and the builds it
+// returns are for use from one thread.
+struct Build_stats {
+    size_t statements = 0;
+    size_t reused = 0;
+    double parse_seconds = 0;   // Spent parsing changed statements in this build
+    double saved_seconds = 0;   // What parsing the reused statements had cost originally
+};
+
+struct Incremental_build {
+    const Slot_table& slots;
+    std::vector<std::shared_ptr<const Stmt>> statements;
+    Build_stats stats;
+};
+
+class Incremental_compiler {
+public:
+    explicit Incremental_compiler(const Native_registry& natives) : m_natives(natives) {}
+
+    // Throws std::runtime_error on a lex or parse error; the previous build's
+    // statements then stay cached for the next attempt.
+    Incremental_build compile(std::string_view source) {
+        std::vector<Token> tokens = tokenize(source);
+        Source_lines lines(source);
+        Incremental_build build{m_slots, {}, {}};
+        Cache next; // Shares entries with m_cache, which stays whole until the end
+
+        size_t begin = 0;
+        while (tokens[begin].type != TokenType::END_OF_FILE) {
+            size_t end = statement_end(tokens, begin);
+            uint64_t fingerprint = hash_tokens(tokens, begin, end);
+
+            const Cached* cached = find(next, fingerprint, tokens, begin, end).get(); // Repeated within this build
+            if (!cached) {
+                if (auto previous = find(m_cache, fingerprint, tokens, begin, end)) {
+                    next[fingerprint].push_back(previous);
+                    cached = previous.get();
+                }
+            }
+            if (cached) {
+                build.stats.reused++;
+                build.stats.saved_seconds += cached->parse_seconds;
+            } else {
+                auto started = std::chrono::steady_clock::now();
+                std::vector<Token> slice(tokens.begin() + begin, tokens.begin() + end);
+                slice.push_back({TokenType::END_OF_FILE, "", tokens[end].offset});
+                Parser parser(slice, &m_natives, m_slots, &lines);
+                std::vector<std::unique_ptr<Stmt>> parsed = parser.parse();
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+                build.stats.parse_seconds += seconds;
+                // The range always holds exactly one statement; keep whatever the parser made of it.
+                std::vector<std::shared_ptr<const Stmt>> statements(std::make_move_iterator(parsed.begin()),
+                                                                     std::make_move_iterator(parsed.end()));
+                next[fingerprint].push_back(
+                    std::make_shared<const Cached>(Cached{key_of(tokens, begin, end), std::move(statements), seconds}));
+                cached = next[fingerprint].back().get();
+            }
+            build.statements.insert(build.statements.end(), cached->statements.begin(), cached->statements.end());
+            build.stats.statements++;
+            begin = end;
+        }
+
+        m_cache = std::move(next); // Statements the new source no longer has are dropped
+        return build;
+    }
+
+private:
+    // One cached statement; `key` holds its tokens so fingerprint collisions
+    // are caught instead of silently running the wrong code.
+    struct Cached {
+        std::vector<std::pair<TokenType, std::string>> key;
+        std::vector<std::shared_ptr<const Stmt>> statements;
+        double parse_seconds;
+    };
+
+    using Cache = std::unordered_map<uint64_t, std::vector<std::shared_ptr<const Cached>>>;
+
+    const Native_registry& m_natives;
+    Slot_table m_slots;
+    Cache m_cache;
+
+    // One past the last token of the top-level statement starting at `begin`:
+    // its ';' or closing '}' at depth zero, unless an 'else' follows.
+    static size_t statement_end(const std::vector<Token>& tokens, size_t begin) {
+        int depth = 0;
+        size_t i = begin;
+        while (tokens[i].type != TokenType::END_OF_FILE) {
+            TokenType type = tokens[i++].type;
+            if (type == TokenType::OPEN_PAREN || type == TokenType::OPEN_BRACE || type == TokenType::OPEN_BRACKET) {
+                depth++;
+            } else if (type == TokenType::CLOSE_PAREN || type == TokenType::CLOSE_BRACE || type == TokenType::CLOSE_BRACKET) {
+                depth--;
+            }
+            bool ends = depth <= 0 && (type == TokenType::SEMICOLON || type == TokenType::CLOSE_BRACE);
+            if (ends && tokens[i].type != TokenType::ELSE) break;
+        }
+        return i;
+    }
+
+    static uint64_t hash_tokens(const std::vector<Token>& tokens, size_t begin, size_t end) {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = begin; i < end; i++) {
+            h ^= static_cast<uint64_t>(tokens[i].type);
+            h *= 1099511628211ull;
+            for (unsigned char c : tokens[i].literal) { h ^= c; h *= 1099511628211ull; }
+            h ^= 0xff; // Separates "ab" "c" from "a" "bc"
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    static std::vector<std::pair<TokenType, std::string>> key_of(const std::vector<Token>& tokens, size_t begin, size_t end) {
+        std::vector<std::pair<TokenType, std::string>> key;
+        key.reserve(end - begin);
+        for (size_t i = begin; i < end; i++) key.emplace_back(tokens[i].type, tokens[i].literal);
+        return key;
+    }
+
+    static std::shared_ptr<const Cached> find(const Cache& cache, uint64_t fingerprint, const std::vector<Token>& tokens,
+                                              size_t begin, size_t end) {
+        auto it = cache.find(fingerprint);
+        if (it == cache.end()) return nullptr;
+        for (const auto& cached : it->second) {
+            if (cached->key.size() != end - begin) continue;
+            bool same = true;
+            for (size_t i = 0; same && i < cached->key.size(); i++) {
+                same = cached->key[i].first == tokens[begin + i].type && cached->key[i].second == tokens[begin + i].literal;
+            }
+            if (same) return cached;
+        }
+        return nullptr;
+    }
+};
+
+// --- Server mode: "Parser --serve <socket>" ---
+// Programs are cached by the hash of their source, with the source kept
+// beside each one so a lookup never trusts the hash alone: when two sources
+// collide, the second takes the next free id. The cache holds at most
+// `capacity` programs and drops the least recently used. Named rules live in
+// a Program_registry, so republishing one never blocks requests running it.
+// Inputs arrive as the array variable `input`, and whatever the program
+// prints is the response body. A program may run at most
+// SERVE_ITERATION_LIMIT loop iterations, so none can hold a pool thread (and
+// the batch it is in) for long.
+class Program_cache {
+public:
+    explicit Program_cache(const Native_registry& natives, size_t capacity = 1024)
+        : m_natives(natives), m_capacity(std::max<size_t>(capacity, 1)) {}
+
+    std::shared_ptr<const Program> find(uint64_t id) {
+        std::shared_ptr<const Entry> entry = lookup(id);
+        return entry ? entry->program : nullptr;
+    }
+
+    std::shared_ptr<const Program> get_or_compile(const std::string& source, uint64_t& id) {
+        id = hash_program(source);
+        // Sources are compared outside the lock; the entries are immutable.
+        for (std::shared_ptr<const Entry> entry; (entry = lookup(id)); id++) {
+            if (entry->source == source) return entry->program;
+        }
+        auto entry = std::make_shared<const Entry>(Entry{source, compile_program(source, m_natives)}); // Outside the lock
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_programs.find(id); it != m_programs.end(); it = m_programs.find(++id)) {
+            if (it->second.entry->source == source) return it->second.entry->program; // A racing duplicate won
+        }
+        m_recent.push_front(id);
+        m_programs.emplace(id, Slot{entry, m_recent.begin()});
+        if (m_programs.size() > m_capacity) {
+            m_programs.erase(m_recent.back());
+            m_recent.pop_back();
+        }
+        return entry->program;
+    }
+
+private:
+    struct Entry {
+        std::string source;
+        std::shared_ptr<const Program> program;
+    };
+    struct Slot {
+        std::shared_ptr<const Entry> entry;
+        std::list<uint64_t>::iterator recent; // Its place in m_recent
+    };
+
+    const Native_registry& m_natives;
+    size_t m_capacity;
+    std::mutex m_mutex;
+    std::unordered_map<uint64_t, Slot> m_programs;
+    std::list<uint64_t> m_recent; // Ids, most recently used first
+
+    // The entry under `id`, now the most recently used; null if none.
+    std::shared_ptr<const Entry> lookup(uint64_t id) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_programs.find(id);
+        if (it == m_programs.end()) return nullptr;
+        m_recent.splice(m_recent.begin(), m_recent, it->second.recent);
+        return it->second.entry;
+    }
+};
+
+Eval_server* g_server = nullptr;
+
+// About half a second of the interpreter's simplest loops.
+constexpr uint64_t SERVE_ITERATION_LIMIT = 1000000;
+
+Eval_response run_program(const Program& program, const std::vector<double>& inputs) {
+    std::ostringstream out, err;
+    Interpreter interpreter(program.slots, out, err);
+    interpreter.define("input", Value::of(inputs));
+    interpreter.set_iteration_limit(SERVE_ITERATION_LIMIT);
+    bool ok = interpreter.interpret(program.statements);
+    Eval_response response;
+    response.status = ok ? Response_status::OK : Response_status::ERROR;
+    response.output = ok ? out.str() : err.str();
+    return response;
+}
+
+int serve(const std::string& socket_path, const Native_registry& natives) {
+    Program_cache cache(natives);
+    Program_registry<Program> rules;
+    Eval_server server(socket_path, [&](const Eval_request& request) {
+        Eval_response response;
+        if (request.kind == Request_kind::PUBLISH_RULE) {
+            size_t newline = request.source.find('\n');
+            if (newline == std::string::npos) throw std::runtime_error("Expect '<name>\\n<source>'.");
+            std::string source = request.source.substr(newline + 1);
+            rules.publish(request.source.substr(0, newline), compile_program(source, natives));
+            response.program_id = hash_program(source);
+            return response;
+        }
+        if (request.kind == Request_kind::RUN_RULE) {
+            auto guard = rules.read();
+            const Program* program = rules.find(request.source, guard);
+            if (!program) {
+                response.status = Response_status::UNKNOWN_PROGRAM;
+                return response;
+            }
+            return run_program(*program, request.inputs);
+        }
+
+        std::shared_ptr<const Program> program;
+        if (request.kind == Request_kind::RUN_CACHED) {
+            response.program_id = request.program_id;
+            program = cache.find(request.program_id);
+            if (!program) {
+                response.status = Response_status::UNKNOWN_PROGRAM;
+                return response;
+            }
+        } else {
+            program = cache.get_or_compile(request.source, response.program_id);
+        }
+        uint64_t id = response.program_id;
+        response = run_program(*program, request.inputs);
+        response.program_id = id;
+        return response;
+    });
+
+    g_server = &server;
+    std::signal(SIGINT, [](int) { g_server->stop(); });
+    std::signal(SIGTERM, [](int) { g_server->stop(); });
+    std::cerr << "Serving SimPL on " << socket_path << " with " << server.threads() << " threads\n";
+    server.run();
+    std::cerr << "Served " << server.requests_served() << " requests\n";
+    g_server = nullptr;
+    return 0;
+}
+
+// Expands directories (recursively) into the regular files beneath them.
+std::vector<std::string> collect_scripts(const std::vector<std::string>& roots) {
+    std::vector<std::string> paths;
+    for (const auto& root : roots) {
+        if (std::filesystem::is_directory(root)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+                if (entry.is_regular_file()) paths.push_back(entry.path().string());
+            }
+        } else {
+            paths.push_back(root);
+        }
+    }
+    return paths;
+}
+
+// --- Batch mode: "Parser --batch <file or directory>..." ---
+// Runs every script (directories are searched recursively). Files are read
+// through Batch_loader and compiled and run by its workers as they arrive;
+// each script's output is printed as one block after a "== path" header.
+int run_batch(const std::vector<std::string>& roots, const Native_registry& natives) {
+    std::vector<std::string> paths = collect_scripts(roots);
+
+    std::mutex print_mutex;
+    std::atomic<size_t> failures{0};
+    std::atomic<size_t> bytes{0};
+    auto started = std::chrono::steady_clock::now();
+
+    Batch_loader loader;
+    loader.load_all(paths, [&](Loaded_file& file) {
+        std::ostringstream out;
+        bool ok = false;
+        if (file.error) {
+            out << "Cannot read: " << std::strerror(file.error) << "\n";
+        } else {
+            bytes += file.contents.size();
+            try {
+                auto program = compile_program(file.contents, natives);
+                Interpreter interpreter(program->slots, out, out);
+                ok = interpreter.interpret(program->statements);
+            } catch (const std::exception& e) {
+                out << e.what() << "\n";
+            }
+        }
+        if (!ok) failures++;
+        std::lock_guard<std::mutex> lock(print_mutex);
+        std::cout << "== " << file.path << "\n" << out.str();
+    });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cerr << paths.size() << " scripts, " << bytes.load() << " bytes, " << failures.load() << " failed, "
+              << seconds << " s (" << (loader.used_io_uring() ? "io_uring" : "blocking I/O fallback") << ")\n";
+    return failures.load() ? 1 : 0;
+}
+
+// --- Bundle mode ---
+// "Parser --bundle-pack <out> <file or directory>..." packs scripts (and their
+// token streams) into one file; "Parser --bundle-run <bundle> <name>..." runs
+// scripts from it, using the stored tokens unless they are from another build.
+int bundle_pack(const std::string& out_path, const std::vector<std::string>& roots) {
+    Bundle_writer writer(TOKEN_STREAM_FORMAT);
+    std::vector<std::string> paths = collect_scripts(roots);
+    for (const auto& path : paths) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("Cannot read " + path);
+        std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::string tokens = encode_tokens(tokenize(source));
+        writer.add(path, std::move(source), std::move(tokens));
+    }
+    writer.write(out_path);
+    std::cerr << "Packed " << paths.size() << " scripts into " << out_path << "\n";
+    return 0;
+}
+
+int bundle_run(const std::string& bundle_path, const std::vector<std::string>& names, const Native_registry& natives) {
+    Bundle_reader bundle(bundle_path);
+    bool use_tokens = bundle.token_format() == TOKEN_STREAM_FORMAT;
+    int status = 0;
+    for (const auto& name : names) {
+        auto entry = bundle.find(name);
+        if (!entry) {
+            std::cerr << "No script named '" << name << "' in " << bundle_path << "\n";
+            status = 1;
+            continue;
+        }
+        try {
+            Source_lines lines(entry->source);
+            auto program = use_tokens && !entry->tokens.empty() ? compile_tokens(decode_tokens(entry->tokens), natives, &lines)
+                                                                : compile_program(entry->source, natives);
+            Interpreter interpreter(program->slots);
+            if (!interpreter.interpret(program->statements)) status = 1;
+        } catch (const std::exception& e) {
+            std::cerr << name << ": " << e.what() << std::endl;
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// --- REPL mode: "Parser --repl" ---
+// One Slot_table and one Interpreter live for the whole session, so each input
+// is lexed and parsed on its own and its variables keep their slots and values.
+// Parsed statements are kept too: nothing already entered is compiled again.
+// An input spans lines until its parentheses, brackets and braces balance; one
+// that does not end in ';' or '}' is printed, so "x * 2" shows its value.
+// ":vars" lists the defined variables, ":time" toggles per-input timing and
+// ":quit" (or end of input) leaves.
+int repl(const Native_registry& natives) {
+    Slot_table slots;
+    Interpreter interpreter(slots);
+    std::vector<std::vector<std::unique_ptr<Stmt>>> history;
+    bool timing = false;
+
+    // Nesting depth of the input so far; above zero it needs more lines.
+    auto depth = [](const std::vector<Token>& tokens) {
+        int open = 0;
+        for (const auto& t : tokens) {
+            switch (t.type) {
+                case TokenType::OPEN_PAREN: case TokenType::OPEN_BRACE: case TokenType::OPEN_BRACKET: open++; break;
+                case TokenType::CLOSE_PAREN: case TokenType::CLOSE_BRACE: case TokenType::CLOSE_BRACKET: open--; break;
+                default: break;
+            }
+        }
+        return open;
+    };
+
+    std::string input;
+    std::string line;
+    while (true) {
+        std::cout << (input.empty() ? "simpl> " : "....> ") << std::flush;
+        if (!std::getline(std::cin, line)) break;
+
+        if (input.empty()) {
+            if (line == ":quit") break;
+            if (line == ":time") {
+                timing = !timing;
+                std::cout << "Timing " << (timing ? "on" : "off") << "\n";
+                continue;
+            }
+            if (line == ":vars") {
+                for (size_t i = 0; i < interpreter.values().size(); i++) {
+                    const Value& value = interpreter.values()[i];
+                    if (!value.is_defined()) continue;
+                    std::cout << slots.name(static_cast<int>(i)) << " = ";
+                    interpreter.write(std::cout, value);
+                    std::cout << "\n";
+                }
+                continue;
+            }
+        }
+        input += line;
+        input += '\n';
+
+        auto started = std::chrono::steady_clock::now();
+        try {
+            std::vector<Token> tokens = tokenize(input);
+            if (depth(tokens) > 0) continue;
+
+            size_t end = input.find_last_not_of(" \t\r\n");
+            if (end == std::string::npos) { input.clear(); continue; }
+            std::string text = input;
+            if (input[end] != ';' && input[end] != '}') {
+                text = "print " + input.substr(0, end + 1) + ";";
+                tokens = tokenize(text);
+            }
+            Source_lines lines(text);
+            Parser parser(tokens, &natives, slots, &lines);
+            history.push_back(parser.parse());
+            interpreter.interpret(history.back());
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+        input.clear();
+        if (timing) {
+            auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started);
+            std::cout << "(" << elapsed.count() << " us)\n";
+        }
+    }
+    std::cout << "\n";
+    return 0;
+}
+
+// --- Incremental mode: "Parser --incremental <file>..." ---
+// Treats the files as successive versions of one script (say, before and
+// after an edit): each is compiled reusing what the previous versions had in
+// common with it, then run. Reuse is reported on stderr after each one.
+int run_incremental(const std::vector<std::string>& paths, const Native_registry& natives) {
+    Incremental_compiler compiler(natives);
+    int status = 0;
+    for (const auto& path : paths) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot read " << path << "\n";
+            status = 1;
+            continue;
+        }
+        std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        try {
+            Incremental_build build = compiler.compile(source);
+            const Build_stats& stats = build.stats;
+            std::cerr << "== " << path << ": " << stats.reused << "/" << stats.statements << " statements reused ("
+                      << (stats.statements ? 100.0 * stats.reused / stats.statements : 0.0) << "%), parsed in "
+                      << stats.parse_seconds << " s, saved ~" << stats.saved_seconds << " s\n";
+            Interpreter interpreter(build.slots);
+            if (!interpreter.interpret(build.statements)) status = 1;
+        } catch (const std::exception& e) {
+            std::cerr << path << ": " << e.what() << std::endl;
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// --- Fuzz mode: "Parser --fuzz <corpus> [seconds] [allocs|time]" ---
+// Searches for inputs that make lexing, parsing and running expensive per
+// byte (see Perf_fuzzer.hpp), starting from the inputs already in <corpus>,
+// and saves the worst it finds back there. "Parser --fuzz-bench <corpus>"
+// replays the corpus and exits non-zero if any input scales super-linearly.
+// Only in a fuzzing build (compiled with -DSIMPL_FUZZ), since counting
+// allocations means replacing the global operator new.
+#ifdef SIMPL_FUZZ
+
+// Every allocation is counted for the fuzzer's cost model.
+void* operator new(std::size_t size) {
+    fuzz_allocations().fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+// Out of line, so GCC does not see free() paired with operator new and warn.
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Lexes, parses and runs one input. Features are the token pairs seen, the
+// kinds of top-level statements, and which error (if any) stopped it.
+void fuzz_one(std::string_view input, Fuzz_features& features, const Native_registry& natives) {
+    auto error_feature = [](uint64_t stage, const std::string& message) {
+        std::string_view kind = message;
+        kind = kind.substr(std::min(kind.size(), kind.find("Error:") + 1)); // Drop the location
+        kind = kind.substr(0, kind.find('\'')); // And any names quoted in it
+        return stage << 56 ^ hash_program(kind);
+    };
+
+    std::vector<Token> tokens;
+    try {
+        tokens = tokenize(input);
+    } catch (const std::exception& e) {
+        features.add(error_feature(1, e.what()));
+        return;
+    }
+    for (size_t i = 1; i < tokens.size(); i++) {
+        features.add(static_cast<uint64_t>(tokens[i - 1].type) << 8 | static_cast<uint64_t>(tokens[i].type));
+    }
+
+    Slot_table slots;
+    std::vector<std::unique_ptr<Stmt>> statements;
+    try {
+        Parser parser(tokens, &natives, slots);
+        statements = parser.parse();
+    } catch (const std::exception& e) {
+        features.add(error_feature(2, e.what()));
+        return;
+    }
+    for (const auto& statement : statements) features.add(3ull << 56 ^ typeid(*statement).hash_code());
+
+    std::ostringstream out;
+    Interpreter interpreter(slots, out, out);
+    interpreter.set_iteration_limit(10000); // Loop counts come straight from the input
+    if (!interpreter.interpret(statements)) features.add(error_feature(4, out.str().substr(out.str().rfind("Runtime Error:"))));
+}
+
+int run_fuzzer(const std::string& corpus, double seconds, Fuzz_metric metric, const Native_registry& natives) {
+    Fuzz_options options;
+    options.metric = metric;
+    options.seconds = seconds;
+    options.iterations = std::numeric_limits<uint64_t>::max();
+    std::vector<std::string> dictionary = {
+        "let ", "print ", "if (", ") ", " else ", "for (i = 0, 10) ", "parallel for (k = 0, 100) reduce(+ s) ",
+        "{", "}", "(", ")", "[", "]", ";", ",", " = ", " + ", " - ", " * ", " / ", " == ", " != ", " < ", " >= ",
+        "x", "y", "s", "i", "input", "[1, 2, 3]", "len(", "sum(", "min(", "max(", "sqrt(", "\"text\"", "// note\n", "\n",
+    };
+    Perf_fuzzer fuzzer([&](std::string_view input, Fuzz_features& features) { fuzz_one(input, features, natives); },
+                       dictionary, options);
+    fuzzer.add_seed("let x = 1;\nlet y = x * 2 + (x / 3);\nprint y;\n");
+    fuzzer.add_seed("let s = 0;\nfor (i = 0, 10) { s = s + i; }\nprint s;\n");
+    fuzzer.add_seed("let xs = [1, 2, 3];\nlet s = 0;\nparallel for (k = 0, 3) reduce(+ s) { s = s + xs[k]; }\nprint sum(xs * 2) + s;\n");
+    fuzzer.add_seed("if (1 < 2) { print len([4, 5]); } else { print max(1, 2); }\n");
+    fuzzer.load_corpus(corpus);
+    fuzzer.run(std::cerr);
+    fuzzer.save_worst(corpus);
+    std::cerr << "Worst inputs saved to " << corpus << "\n";
+    return 0;
+}
+
+int run_fuzz_benchmarks(const std::string& corpus, const Native_registry& natives) {
+    Fuzz_target target = [&](std::string_view input, Fuzz_features& features) { fuzz_one(input, features, natives); };
+    return run_benchmarks(corpus, target, std::cout) ? 1 : 0;
+}
+
+#endif // SIMPL_FUZZ
+
+// --- Debug mode: "Parser --debug <file>" ---
+// Runs the script under the Debugger, paused before the first statement.
+// "Parser --debug-bench <file> [runs]" times the script with and without the
+// debugger attached (and nothing set), which should be the same.
+std::string read_script(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot read " + path);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+int run_debugger(const std::string& path, const Native_registry& natives) {
+    std::string source = read_script(path);
+    Source_lines lines(source);
+    auto program = compile_program(source, natives);
+    Debugger debugger(program->statements, program->slots, lines, std::cin, std::cout);
+    debugger.set_stepping(true);
+    Interpreter interpreter(program->slots);
+    return interpreter.interpret(program->statements) ? 0 : 1;
+}
+
+int run_debugger_benchmark(const std::string& path, int runs, const Native_registry& natives) {
+    std::string source = read_script(path);
+    Source_lines lines(source);
+    auto program = compile_program(source, natives);
+    auto time_runs = [&] {
+        auto started = std::chrono::steady_clock::now();
+        for (int i = 0; i < runs; i++) {
+            std::ostringstream out;
+            Interpreter interpreter(program->slots, out, out);
+            interpreter.interpret(program->statements);
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count() / runs;
+    };
+    time_runs(); // Warm up
+    double plain = time_runs();
+    std::istringstream no_input;
+    Debugger debugger(program->statements, program->slots, lines, no_input, std::cerr);
+    double attached = time_runs();
+    std::cout << "without debugger: " << plain * 1e3 << " ms/run\n"
+              << "debugger attached: " << attached * 1e3 << " ms/run (" << debugger.hooked() << " statements hooked, "
+              << (attached / plain - 1) * 100 << "% difference)\n";
+    return 0;
+}
+
+// "Parser --string-bench [megabytes]" builds one large string by appending a
+// 100-byte literal in a loop, with a short-lived string made alongside each
+// step for the collector to reclaim. It then indexes the string and compares
+// it (which flattens the rope) and reports the string heap's statistics.
+int run_string_benchmark(double megabytes, const Native_registry& natives) {
+    std::string chunk(100, '.');
+    chunk.back() = '!';
+    size_t steps = static_cast<size_t>(megabytes * 1e6 / chunk.size());
+    std::string source = "let s = \"\";\n"
+                         "for (i = 0, " + std::to_string(steps) + ") {\n"
+                         "    s = s + \"" + chunk + "\";\n"
+                         "    let scratch = s + \"?\";\n"
+                         "}\n"
+                         "print len(s);\n"
+                         "print s[len(s) - 1];\n"
+                         "print s > \".\";\n";
+    auto program = compile_program(source, natives);
+    Interpreter interpreter(program->slots);
+    auto started = std::chrono::steady_clock::now();
+    bool ok = interpreter.interpret(program->statements);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    String_heap::Stats stats = interpreter.strings().stats();
+    std::cout << steps << " concatenations in " << seconds * 1e3 << " ms\n"
+              << "string heap: " << stats.arena_bytes / 1e6 << " MB arena, " << stats.live_nodes << " nodes, "
+              << stats.collections << " collections reclaimed " << stats.reclaimed_nodes << " nodes and "
+              << stats.reclaimed_bytes / 1e6 << " MB\n";
+    return ok ? 0 : 1;
+}
+
+// "Parser --call-bench [calls]" measures what a native call costs. The thunk
+// is timed on its own, against calling the C++ function directly, and then
+// from a script: a loop calling max(s, i) against the same loop with s + i
+// in its place, so the difference is the call expression itself.
+int run_call_benchmark(size_t calls, const Native_registry& natives) {
+    const Native_function* fn = natives.find("max");
+    double (*volatile direct)(double, double) = host_max; // Not inlined, like the thunk
+    auto per_call_ns = [&](auto&& body) {
+        auto started = std::chrono::steady_clock::now();
+        double s = 0;
+        for (size_t i = 0; i < calls; i++) s = body(s, static_cast<double>(i));
+        volatile double sink = s;
+        (void)sink;
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / calls;
+    };
+    double direct_ns = per_call_ns([&](double s, double i) { return direct(s, i); });
+    double thunk_ns = per_call_ns([&](double s, double i) {
+        double args[MAX_NATIVE_ARGS] = {s, i};
+        return fn->thunk(args);
+    });
+
+    auto per_iteration_ns = [&](const std::string& body) {
+        auto program = compile_program("let s = 0;\nfor (i = 0, " + std::to_string(calls) + ") { " + body + " }\n", natives);
+        Interpreter interpreter(program->slots);
+        auto started = std::chrono::steady_clock::now();
+        interpreter.interpret(program->statements);
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / calls;
+    };
+    double plain_ns = per_iteration_ns("s = s + i;");
+    double calling_ns = per_iteration_ns("s = max(s, i);");
+    std::cout << "direct C++ call: " << direct_ns << " ns, through the thunk: " << thunk_ns << " ns\n"
+              << "script loop with s + i: " << plain_ns << " ns/iteration, with max(s, i): " << calling_ns
+              << " ns/iteration (" << calling_ns - plain_ns << " ns per call)\n";
+    return 0;
+}
+
+// "Parser --array-bench [elements]" measures element throughput on arrays of
+// that size: simd_binary() and simd_sum() against plain scalar loops, and a
+// script doing "xs * 2 + 1" and sum(xs), so the interpreter's share shows.
+int run_array_benchmark(size_t elements, const Native_registry& natives) {
+    elements = std::max<size_t>(elements, 1);
+    std::vector<double> xs(elements), out(elements);
+    for (size_t i = 0; i < elements; i++) xs[i] = static_cast<double>(i % 1000) * 0.5;
+    size_t rounds = std::max<size_t>(1, 100000000 / elements); // About 1e8 elements each
+    auto elements_per_ns = [&](auto&& body) {
+        auto started = std::chrono::steady_clock::now();
+        double sink = 0;
+        for (size_t r = 0; r < rounds; r++) sink += body();
+        volatile double keep = sink;
+        (void)keep;
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+        return static_cast<double>(rounds * elements) / ns;
+    };
+    double two = 2.0;
+    double simd_mul = elements_per_ns([&] {
+        simd_binary(Simd_op::MUL, xs.data(), false, &two, true, out.data(), elements);
+        return out[elements / 2];
+    });
+    double scalar_mul = elements_per_ns([&] {
+        double* volatile target = out.data(); // Keeps the compiler from vectorizing it
+        for (size_t i = 0; i < elements; i++) target[i] = xs[i] * two;
+        return out[elements / 2];
+    });
+    double simd_total = elements_per_ns([&] { return simd_sum(xs.data(), elements); });
+    double scalar_total = elements_per_ns([&] {
+        double total = 0;
+        for (size_t i = 0; i < elements; i++) total += xs[i];
+        return total;
+    });
+
+    auto program = compile_program("let ys = xs * 2 + 1;\nlet total = sum(ys);\n", natives);
+    Interpreter interpreter(program->slots);
+    interpreter.define("xs", Value::of(xs));
+    double script = elements_per_ns([&] { return interpreter.interpret(program->statements) ? 1.0 : 0.0; });
+
+    std::cout << elements << " elements, " << rounds << " rounds (elements per ns)\n"
+              << "a * 2:  simd " << simd_mul << ", scalar " << scalar_mul << "\n"
+              << "sum(a): simd " << simd_total << ", scalar " << scalar_total << "\n"
+              << "script \"ys = xs * 2 + 1; sum(ys)\": " << script << "\n";
+    return 0;
+}
+
+// --- Warm start: "Parser --warm <setup> <snapshot> <query>..." ---
+// Runs <setup> once and saves the variables it leaves to <snapshot> (see
+// Snapshot_file.hpp). Later runs with the same setup source map the snapshot
+// and restore those variables instead of running the setup again. Then each
+// query script runs against them, REPL-style: one slot table and one
+// interpreter, so queries see the setup's variables and each other's.
+void save_snapshot(const std::string& path, std::string program, const Slot_table& slots,
+                   const Interpreter& interpreter) {
+    Snapshot_writer writer(std::move(program));
+    const std::vector<Value>& values = interpreter.values();
+    for (size_t i = 0; i < slots.size(); i++) {
+        const std::string& name = slots.name(static_cast<int>(i));
+        const Value value = i < values.size() ? values[i] : Value::undefined();
+        if (value.is_array()) writer.add_array(name, value.array->data(), value.array->size());
+        else if (value.is_string()) writer.add_string(name, interpreter.strings().to_string(value.string));
+        else if (value.is_defined()) writer.add_number(name, value.number);
+        else writer.add_undefined(name);
+    }
+    writer.write(path);
+}
+
+// Fills the empty `slots` and `interpreter` from the snapshot at `path`.
+// Returns false (having changed nothing) if there is no snapshot, it cannot
+// be read (truncated, corrupt, from another snapshot version), or it was
+// made by another version of `program`; the caller then runs the setup and
+// overwrites it. Arrays are copied out of the mapping, since an array Value
+// owns its elements; numbers and strings are small anyway.
+bool restore_snapshot(const std::string& path, std::string_view program, Slot_table& slots, Interpreter& interpreter) {
+    if (!std::filesystem::exists(path)) return false;
+    std::unique_ptr<Snapshot_reader> reader;
+    try {
+        reader = std::make_unique<Snapshot_reader>(path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "; running the setup again\n";
+        return false;
+    }
+    const Snapshot_reader& snapshot = *reader;
+    if (snapshot.program() != program) return false;
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        Snapshot_slot slot = snapshot.at(i);
+        std::string name(slot.name);
+        slots.resolve(name);
+        switch (slot.kind) {
+            case Snapshot_kind::NUMBER: interpreter.define(name, Value::of(slot.number)); break;
+            case Snapshot_kind::ARRAY:
+                interpreter.define(name, Value::of(std::vector<double>(slot.elements, slot.elements + slot.count)));
+                break;
+            case Snapshot_kind::STRING: interpreter.define(name, Value::of_string(interpreter.strings().from_text(slot.text))); break;
+            case Snapshot_kind::UNDEFINED: break;
+        }
+    }
+    return true;
+}
+
+int run_warm(const std::string& setup_path, const std::string& snapshot_path, const std::vector<std::string>& queries,
+             const Native_registry& natives) {
+    std::string setup = read_script(setup_path);
+    Slot_table slots;
+    Interpreter interpreter(slots);
+    auto compile_and_run = [&](const std::string& source) {
+        std::vector<Token> tokens = tokenize(source);
+        Source_lines lines(source);
+        Parser parser(tokens, &natives, slots, &lines);
+        std::vector<std::unique_ptr<Stmt>> statements = parser.parse();
+        return interpreter.interpret(statements);
+    };
+
+    auto started = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&] { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count(); };
+    if (restore_snapshot(snapshot_path, setup, slots, interpreter)) {
+        std::cerr << "Restored " << slots.size() << " variables from " << snapshot_path << " in " << elapsed_ms() << " ms\n";
+    } else {
+        if (!compile_and_run(setup)) return 1;
+        double setup_ms = elapsed_ms();
+        save_snapshot(snapshot_path, setup, slots, interpreter);
+        std::cerr << "Ran " << setup_path << " in " << setup_ms << " ms; saved " << slots.size() << " variables to "
+                  << snapshot_path << "\n";
+    }
+
+    int status = 0;
+    for (const auto& path : queries) {
+        try {
+            if (!compile_and_run(read_script(path))) status = 1;
+        } catch (const std::exception& e) {
+            std::cerr << path << ": " << e.what() << std::endl;
+            status = 1;
+        }
+    }
+    return status;
+}
+
+int main(int argc, char** argv) {
+    Native_registry natives;
+    register_host_functions(natives);
+
+    std::string mode = argc > 1 ? argv[1] : "";
+    try {
+        if (mode == "--serve" && argc == 3) {
+            return serve(argv[2], natives);
+        }
+        if (mode == "--load-gen" && argc >= 3) {
+            unsigned connections = argc > 3 ? std::stoul(argv[3]) : 4;
+            unsigned requests = argc > 4 ? std::stoul(argv[4]) : 10000;
+            run_load_generator(argv[2], "print sum(input * input) + 1;", connections, requests);
+            return 0;
+        }
+        if (mode == "--batch" && argc >= 3) {
+            return run_batch(std::vector<std::string>(argv + 2, argv + argc), natives);
+        }
+        if (mode == "--bundle-pack" && argc >= 4) {
+            return bundle_pack(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        }
+        if (mode == "--bundle-run" && argc >= 4) {
+            return bundle_run(argv[2], std::vector<std::string>(argv + 3, argv + argc), natives);
+        }
+        if (mode == "--repl" && argc == 2) {
+            return repl(natives);
+        }
+        if (mode == "--incremental" && argc >= 3) {
+            return run_incremental(std::vector<std::string>(argv + 2, argv + argc), natives);
+        }
+#ifdef SIMPL_FUZZ
+        if (mode == "--fuzz" && argc >= 3 && argc <= 5) {
+            double seconds = argc > 3 ? std::stod(argv[3]) : 60;
+            Fuzz_metric metric = argc > 4 && std::string(argv[4]) == "time" ? Fuzz_metric::TIME : Fuzz_metric::ALLOCATIONS;
+            return run_fuzzer(argv[2], seconds, metric, natives);
+        }
+        if (mode == "--fuzz-bench" && argc == 3) {
+            return run_fuzz_benchmarks(argv[2], natives);
+        }
+#endif
+        if (mode == "--debug" && argc == 3) {
+            return run_debugger(argv[2], natives);
+        }
+        if (mode == "--debug-bench" && (argc == 3 || argc == 4)) {
+            return run_debugger_benchmark(argv[2], argc > 3 ? std::stoi(argv[3]) : 20, natives);
+        }
+        if (mode == "--warm" && argc >= 4) {
+            return run_warm(argv[2], argv[3], std::vector<std::string>(argv + 4, argv + argc), natives);
+        }
+        if (mode == "--string-bench" && argc <= 3) {
+            return run_string_benchmark(argc > 2 ? std::stod(argv[2]) : 100, natives);
+        }
+        if (mode == "--call-bench" && argc <= 3) {
+            return run_call_benchmark(argc > 2 ? std::stoul(argv[2]) : 10000000, natives);
+        }
+        if (mode == "--array-bench" && argc <= 3) {
+            return run_array_benchmark(argc > 2 ? std::stoul(argv[2]) : 100000, natives);
+        }
+        if (!mode.empty()) {
+            std::cerr << "Usage: " << argv[0] << " [--repl | --serve <socket> | --load-gen <socket> [connections] [requests] |"
+                      << " --batch <file or directory>... | --bundle-pack <out> <file or directory>... |"
+                      << " --bundle-run <bundle> <name>... | --incremental <file>... |"
+#ifdef SIMPL_FUZZ
+                      << " --fuzz <corpus> [seconds] [allocs|time] | --fuzz-bench <corpus> |"
+#endif
+                      << " --debug <file> | --debug-bench <file> [runs] | --string-bench [megabytes] |"
+                      << " --call-bench [calls] | --array-bench [elements] |"
+                      << " --warm <setup> <snapshot> <query>...]\n";
+            return 2;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::string source = R"(
+        let a = 10;
+        let b = 0;
+
+        if (a > 5) {
+            b = a * 2 + (a / 5); // b should become 10*2 + 2 = 22
+            print b;
+        } else {
+            print 999; // This part should not run
+        }
+
+        let c = b - 2; // c should be 22 - 2 = 20
+        print c;
+        print sqrt(c * 5); // Host call, should be 10
+
+        let xs = [1, 2, 3, 4, 5];
+        let ys = xs * 2 + 1; // Element-wise: [3, 5, 7, 9, 11]
+        print ys;
+        print sum(ys) / len(ys); // 7
+        print min(ys == 2 * xs + 1); // Every element matches: 1
+
+        let total = 0;
+        let peak = 0;
+        parallel for (i = 0, 100) reduce(+ total, max peak) {
+            let sq = i * i;
+            total = total + sq;
+            peak = max(peak, sq);
+        }
+        print total; // 328350
+        print peak;  // 9801
+    )";
+
+    std::cout << "--- Compiling and Running SimPL Code ---\n";
+    try {
+        // Step 1: Lexing (Source Code -> Tokens)
+        std::vector<Token> tokens = tokenize(source);
+
+        // Step 2: Parsing (Tokens -> AST)
+        Slot_table slots;
+        Source_lines lines(source);
+        Parser parser(tokens, &natives, slots, &lines);
+        std::vector<std::unique_ptr<Stmt>> statements = parser.parse();
+
+        // Step 3: Interpreting (AST -> Output)
+        Interpreter interpreter(slots);
+        interpreter.interpret(statements);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// =======================================================================
+// ==          PERFORMANCE FUZZER (Worst-Case Input Search)             ==
+// =======================================================================
+// Looks for inputs that are expensive for their size instead of inputs that
+// crash. Each candidate is run through a target (e.g. lex + parse + run) and
+// scored by allocations or nanoseconds per input byte, beyond what running
+// the target on an empty input costs; otherwise that fixed cost would make
+// the shortest inputs look the worst. Two things steer the search:
+//
+//   coverage  the target reports "features" it hit (token pairs, statement
+//             kinds, which error fired); an input with a new feature joins
+//             the queue of inputs to mutate further
+//   cost      the highest-scoring inputs are kept, and mutated more often
+//
+// The worst inputs are saved to a corpus directory. run_benchmarks() replays
+// a corpus, each input repeated 1, 4 and 16 times, and flags any whose cost
+// (again beyond the empty input's) grows faster than linearly with the
+// repetition, which is how super-linear behavior shows up before it bites
+// in production.
+//
+// Allocations are counted in fuzz_allocations(), which the program must bump
+// from a replacement global operator new. Parser.cpp does when built with
+// -DSIMPL_FUZZ, and only then includes this file.
+
+// Allocations made by every thread so far, so that the work a target hands
+// to other threads (a parallel for's workers) is counted too. Only one
+// target runs at a time.
+inline std::atomic<uint64_t>& fuzz_allocations() {
+    static std::atomic<uint64_t> count{0};
+    return count;
+}
+
+// Distinct behaviors one run of the target hit, as opaque hashes.
+class Fuzz_features {
+public:
+    void add(uint64_t feature) { m_features.push_back(feature); }
+    const std::vector<uint64_t>& all() const { return m_features; }
+    void clear() { m_features.clear(); }
+
+private:
+    std::vector<uint64_t> m_features;
+};
+
+inline std::string read_fuzz_input(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+using Fuzz_target = std::function<void(std::string_view input, Fuzz_features& features)>;
+
+enum class Fuzz_metric { ALLOCATIONS, TIME };
+
+struct Fuzz_cost {
+    uint64_t allocations = 0;
+    double seconds = 0;
+
+    // The cost beyond `baseline`, e.g. what the target costs on an empty input.
+    Fuzz_cost above(const Fuzz_cost& baseline) const {
+        return {allocations > baseline.allocations ? allocations - baseline.allocations : 0,
+                std::max(seconds - baseline.seconds, 0.0)};
+    }
+
+    double per_byte(Fuzz_metric metric, size_t bytes) const {
+        double total = metric == Fuzz_metric::ALLOCATIONS ? static_cast<double>(allocations) : seconds * 1e9;
+        return total / static_cast<double>(std::max<size_t>(bytes, 1));
+    }
+};
+
+// Runs `target` once on `input` and measures it. Time is the best of `runs`.
+inline Fuzz_cost measure_fuzz_input(const Fuzz_target& target, std::string_view input, Fuzz_features& features,
+                                    int runs = 1) {
+    Fuzz_cost cost;
+    cost.seconds = INFINITY;
+    for (int i = 0; i < runs; i++) {
+        features.clear();
+        uint64_t before = fuzz_allocations().load(std::memory_order_relaxed);
+        auto started = std::chrono::steady_clock::now();
+        target(input, features);
+        cost.seconds = std::min(cost.seconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+        cost.allocations = fuzz_allocations().load(std::memory_order_relaxed) - before;
+    }
+    return cost;
+}
+
+struct Fuzz_options {
+    Fuzz_metric metric = Fuzz_metric::ALLOCATIONS;
+    uint64_t iterations = 100000;
+    double seconds = 60;
+    size_t max_input = 4096;   // Bytes; longer mutants are truncated
+    size_t min_input = 32;     // Bytes; shorter inputs feed coverage but are not scored
+    size_t keep_worst = 16;    // Inputs saved to the corpus
+    uint64_t seed = 1;
+};
+
+class Perf_fuzzer {
+public:
+    // `dictionary` holds fragments (keywords, operators, ...) that mutations
+    // splice in, so most mutants still get past the lexer.
+    Perf_fuzzer(Fuzz_target target, std::vector<std::string> dictionary, Fuzz_options options)
+        : m_target(std::move(target)), m_dictionary(std::move(dictionary)), m_options(options), m_rng(options.seed) {
+        m_baseline = measure_fuzz_input(m_target, "", m_features, 5);
+    }
+
+    void add_seed(std::string input) { consider(std::move(input)); }
+
+    // Adds every regular file in `dir` (if it exists) as a seed.
+    void load_corpus(const std::string& dir) {
+        if (!std::filesystem::is_directory(dir)) return;
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            if (entry.is_regular_file()) add_seed(read_fuzz_input(entry.path().string()));
+        }
+    }
+
+    // Mutates until the iteration or time budget runs out; reports progress on `log`.
+    void run(std::ostream& log) {
+        if (m_queue.empty()) m_queue.push_back(""); // Mutations need a parent
+        auto started = std::chrono::steady_clock::now();
+        auto elapsed = [&] { return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count(); };
+        double next_report = 1;
+        uint64_t i = 0;
+        for (; i < m_options.iterations && elapsed() < m_options.seconds; i++) {
+            consider(mutate());
+            if (elapsed() >= next_report) {
+                report(log, i + 1, elapsed());
+                next_report *= 2;
+            }
+        }
+        report(log, i, elapsed());
+    }
+
+    // Writes the worst inputs into `dir` as perf-<hash>.simpl (existing files are kept).
+    void save_worst(const std::string& dir) const {
+        std::filesystem::create_directories(dir);
+        for (const auto& w : m_worst) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "perf-%016llx.simpl", static_cast<unsigned long long>(hash(w.input)));
+            std::ofstream(std::filesystem::path(dir) / name, std::ios::binary) << w.input;
+        }
+    }
+
+    struct Scored {
+        std::string input;
+        double score;
+    };
+    const std::vector<Scored>& worst() const { return m_worst; }
+
+private:
+    Fuzz_target m_target;
+    std::vector<std::string> m_dictionary;
+    Fuzz_options m_options;
+    std::mt19937_64 m_rng;
+
+    std::vector<std::string> m_queue;          // Inputs that found new features
+    std::unordered_set<uint64_t> m_seen;       // Every feature found so far
+    std::unordered_set<uint64_t> m_tried;      // Inputs already run, by hash
+    std::vector<Scored> m_worst;               // Highest score first
+    Fuzz_features m_features;
+    Fuzz_cost m_baseline;                      // The target on an empty input
+
+    void consider(std::string input) {
+        if (input.size() > m_options.max_input) input.resize(m_options.max_input);
+        if (!m_tried.insert(hash(input)).second) return;
+
+        Fuzz_cost cost = measure_fuzz_input(m_target, input, m_features);
+        bool novel = false;
+        for (uint64_t f : m_features.all()) novel |= m_seen.insert(f).second;
+        if (novel) m_queue.push_back(input);
+        if (input.size() < m_options.min_input) return;
+
+        double score = cost.above(m_baseline).per_byte(m_options.metric, input.size());
+        if (m_worst.size() < m_options.keep_worst || score > m_worst.back().score) {
+            if (m_options.metric == Fuzz_metric::TIME) { // One run is noisy; confirm before keeping
+                score = measure_fuzz_input(m_target, input, m_features, 3).above(m_baseline).per_byte(m_options.metric, input.size());
+                if (m_worst.size() >= m_options.keep_worst && score <= m_worst.back().score) return;
+            }
+            auto at = std::find_if(m_worst.begin(), m_worst.end(), [&](const Scored& w) { return w.score < score; });
+            m_worst.insert(at, {std::move(input), score});
+            if (m_worst.size() > m_options.keep_worst) m_worst.pop_back();
+        }
+    }
+
+    // Picks a parent (the worst inputs half the time, so cost is climbed
+    // directly) and applies a few random edits.
+    std::string mutate() {
+        bool from_worst = !m_worst.empty() && pick(2) == 0;
+        std::string s = from_worst ? m_worst[pick(m_worst.size())].input : m_queue[pick(m_queue.size())];
+        for (size_t edits = 1 + pick(4); edits > 0; edits--) {
+            size_t at = pick(s.size() + 1);
+            switch (pick(6)) {
+                case 0: // Insert a dictionary fragment
+                    if (!m_dictionary.empty()) s.insert(at, m_dictionary[pick(m_dictionary.size())]);
+                    break;
+                case 1: // Duplicate a range: repetition is what exposes super-linear costs
+                    if (!s.empty()) {
+                        size_t from = pick(s.size()), length = 1 + pick(std::min<size_t>(s.size() - from, 64));
+                        std::string range = s.substr(from, length);
+                        for (size_t copies = 1 + pick(8); copies > 0; copies--) s.insert(at, range);
+                    }
+                    break;
+                case 2: // Delete a range
+                    if (!s.empty()) {
+                        size_t from = pick(s.size());
+                        s.erase(from, 1 + pick(std::min<size_t>(s.size() - from, 16)));
+                    }
+                    break;
+                case 3: // Replace a byte with a printable one
+                    if (!s.empty()) s[pick(s.size())] = static_cast<char>(' ' + pick(95));
+                    break;
+                case 4: // Splice in part of another queued input
+                    {
+                        const std::string& other = m_queue[pick(m_queue.size())];
+                        if (!other.empty()) {
+                            size_t from = pick(other.size());
+                            s.insert(at, other, from, 1 + pick(std::min<size_t>(other.size() - from, 64)));
+                        }
+                    }
+                    break;
+                default: // Insert a short run of digits
+                    s.insert(at, std::to_string(pick(100000)));
+                    break;
+            }
+        }
+        return s;
+    }
+
+    size_t pick(size_t bound) { return bound ? static_cast<size_t>(m_rng() % bound) : 0; }
+
+    void report(std::ostream& log, uint64_t iterations, double seconds) const {
+        log << "[fuzz] " << iterations << " runs in " << seconds << " s, " << m_queue.size() << " queued, "
+            << m_seen.size() << " features, worst " << (m_worst.empty() ? 0.0 : m_worst.front().score)
+            << (m_options.metric == Fuzz_metric::ALLOCATIONS ? " allocations/byte" : " ns/byte") << "\n";
+    }
+
+    static uint64_t hash(std::string_view s) {
+        uint64_t h = 14695981039346656037ull;
+        for (unsigned char c : s) { h ^= c; h *= 1099511628211ull; }
+        return h;
+    }
+};
+
+// Replays every input in `dir` at 1x, 4x and 16x repetition and prints how
+// its cost beyond the empty input's grows. An exponent near 1 is linear; an
+// input whose allocations grow with exponent above 1.25, or whose time does
+// with exponent above 1.5 (timing is noisier), is flagged. Returns the
+// number of flagged inputs.
+inline int run_benchmarks(const std::string& dir, const Fuzz_target& target, std::ostream& out) {
+    std::vector<std::string> paths;
+    if (std::filesystem::is_directory(dir)) {
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            if (entry.is_regular_file()) paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    int flagged = 0;
+    Fuzz_features features;
+    Fuzz_cost baseline = measure_fuzz_input(target, "", features, 5);
+    for (const auto& path : paths) {
+        std::string input = read_fuzz_input(path);
+        Fuzz_cost costs[3];
+        const int repeats[3] = {1, 4, 16};
+        for (int k = 0; k < 3; k++) {
+            std::string scaled;
+            for (int r = 0; r < repeats[k]; r++) { scaled += input; scaled += '\n'; }
+            costs[k] = measure_fuzz_input(target, scaled, features, 5).above(baseline);
+        }
+        auto exponent = [](double small, double large) {
+            return small > 0 && large > 0 ? std::log(large / small) / std::log(16.0) : 1.0;
+        };
+        double alloc_exp = exponent(static_cast<double>(costs[0].allocations), static_cast<double>(costs[2].allocations));
+        // Runs under 20 us are mostly timer noise; judge those by allocations alone.
+        double time_exp = costs[0].seconds > 20e-6 ? exponent(costs[0].seconds, costs[2].seconds) : 1.0;
+        bool bad = alloc_exp > 1.25 || time_exp > 1.5;
+        flagged += bad;
+        out << (bad ? "SUPER-LINEAR " : "ok           ") << path << ": " << input.size() << " bytes, "
+            << costs[0].seconds * 1e6 << " / " << costs[1].seconds * 1e6 << " / " << costs[2].seconds * 1e6 << " us, "
+            << costs[0].allocations << " / " << costs[1].allocations << " / " << costs[2].allocations
+            << " allocations (growth exponent: time " << time_exp << ", allocations " << alloc_exp << ")\n";
+    }
+    out << paths.size() << " inputs, " << flagged << " super-linear\n";
+    return flagged;
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// =======================================================================
+// ==        PROGRAM REGISTRY (Read-Copy-Update Publication)            ==
+// =======================================================================
+// Lets a running service swap the program behind a name without stopping
+// anything. Readers never lock: they enter an epoch, load an atomic pointer,
+// and run whatever version they got for as long as they like. A writer swaps
+// in the new version and retires the old one; it is deleted only once every
+// reader that could still see it has left its epoch.
+//
+//     auto guard = registry.read();
+//     if (const Program* p = registry.find("pricing", guard)) run(*p);
+//
+//     registry.publish("pricing", std::move(new_program)); // From any thread
+
+// =======================================================================
+// ==               PART 1: EPOCH-BASED RECLAMATION                     ==
+// =======================================================================
+// Each reader thread has a slot holding the global epoch it entered at, or 0
+// when it is outside any read section. Retiring bumps the global epoch; an
+// object retired at epoch E is safe to delete once no slot holds a value
+// below E, because every later reader started after the object was unlinked.
+//
+// A thread finds its slot through a thread_local lease, which is per thread,
+// not per domain, so there is exactly one domain. It is never destroyed: a
+// thread that exits during or after static destruction still hands its slot
+// back to a live domain. What is still retired at exit is left to the OS.
+
+class Epoch_domain {
+public:
+    static Epoch_domain& instance() {
+        static Epoch_domain* domain = new Epoch_domain();
+        return *domain;
+    }
+
+    Epoch_domain(const Epoch_domain&) = delete;
+    Epoch_domain& operator=(const Epoch_domain&) = delete;
+
+private:
+    struct Reader {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> in_use{false};
+        unsigned nesting = 0; // Only touched by the owning thread
+    };
+
+public:
+    // Marks the calling thread as reading. Guards nest; only the outermost counts.
+    class Read_guard {
+    public:
+        explicit Read_guard(Epoch_domain& domain) : m_reader(domain.local_reader()) {
+            if (m_reader->nesting++ == 0) {
+                m_reader->epoch.store(domain.m_epoch.load());
+            }
+        }
+        ~Read_guard() {
+            if (--m_reader->nesting == 0) {
+                m_reader->epoch.store(0, std::memory_order_release);
+            }
+        }
+        Read_guard(const Read_guard&) = delete;
+        Read_guard& operator=(const Read_guard&) = delete;
+
+    private:
+        Reader* m_reader;
+    };
+
+    Read_guard read() { return Read_guard(*this); }
+
+    // Hands over an already-unlinked object; `free` runs once no reader can see it.
+    void retire(std::function<void()> free) {
+        uint64_t epoch = m_epoch.fetch_add(1) + 1;
+        {
+            std::lock_guard<std::mutex> lock(m_retired_mutex);
+            m_retired.push_back({epoch, std::move(free)});
+        }
+        reclaim();
+    }
+
+    // Frees every retired object that no reader can still hold.
+    void reclaim() {
+        uint64_t oldest = oldest_active_epoch();
+        std::vector<Retired> ready;
+        {
+            std::lock_guard<std::mutex> lock(m_retired_mutex);
+            auto keep = m_retired.begin();
+            for (auto it = m_retired.begin(); it != m_retired.end(); ++it) {
+                if (it->epoch <= oldest) ready.push_back(std::move(*it));
+                else *keep++ = std::move(*it);
+            }
+            m_retired.erase(keep, m_retired.end());
+        }
+        for (auto& r : ready) r.free(); // Outside the lock; destructors may be slow
+    }
+
+    // Blocks until everything retired so far has been freed.
+    void synchronize() {
+        while (true) {
+            reclaim();
+            {
+                std::lock_guard<std::mutex> lock(m_retired_mutex);
+                if (m_retired.empty()) return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(m_retired_mutex);
+        return m_retired.size();
+    }
+
+private:
+    struct Retired {
+        uint64_t epoch;
+        std::function<void()> free;
+    };
+
+    Epoch_domain() = default;
+
+    std::atomic<uint64_t> m_epoch{1};
+    std::mutex m_readers_mutex;
+    std::vector<std::unique_ptr<Reader>> m_readers;
+    std::mutex m_retired_mutex;
+    std::vector<Retired> m_retired;
+
+    // Releases the thread's slot for reuse when the thread exits.
+    struct Reader_lease {
+        Reader* reader = nullptr;
+        ~Reader_lease() {
+            if (reader) { reader->epoch.store(0); reader->in_use.store(false); }
+        }
+    };
+
+    Reader* local_reader() {
+        thread_local Reader_lease lease;
+        if (!lease.reader) lease.reader = acquire_reader();
+        return lease.reader;
+    }
+
+    // Registration happens once per thread, so taking a lock here is fine.
+    Reader* acquire_reader() {
+        std::lock_guard<std::mutex> lock(m_readers_mutex);
+        for (auto& r : m_readers) {
+            bool expected = false;
+            if (r->in_use.compare_exchange_strong(expected, true)) return r.get();
+        }
+        m_readers.push_back(std::make_unique<Reader>());
+        m_readers.back()->in_use.store(true);
+        return m_readers.back().get();
+    }
+
+    // Smallest epoch any reader is inside, or "infinity" if none is reading.
+    uint64_t oldest_active_epoch() {
+        uint64_t oldest = UINT64_MAX;
+        std::lock_guard<std::mutex> lock(m_readers_mutex);
+        for (auto& r : m_readers) {
+            uint64_t e = r->epoch.load();
+            if (e != 0 && e < oldest) oldest = e;
+        }
+        return oldest;
+    }
+};
+
+// =======================================================================
+// ==               PART 2: NAMED PROGRAM REGISTRY                      ==
+// =======================================================================
+// The name -> slot table is itself published the same way, so finding a
+// program by name on the evaluation path is lock-free too. Slots live as
+// long as the registry; only the programs inside them are swapped.
+
+template <typename T>
+class Program_registry {
+public:
+    using Read_guard = Epoch_domain::Read_guard;
+
+    Program_registry() : m_domain(Epoch_domain::instance()), m_names(new Name_map()) {}
+
+    // Assumes no reader is still inside a read section.
+    ~Program_registry() {
+        m_domain.synchronize();
+        for (auto& slot : m_slots) delete slot->program.load();
+        delete m_names.load();
+    }
+
+    Program_registry(const Program_registry&) = delete;
+    Program_registry& operator=(const Program_registry&) = delete;
+
+    Read_guard read() { return m_domain.read(); }
+
+    // The current version of `name`, or nullptr. Stays valid while `guard` lives.
+    const T* find(std::string_view name, const Read_guard& guard) const {
+        (void)guard;
+        // Sequentially consistent loads: they must not move above the guard's epoch store.
+        const Name_map* names = m_names.load();
+        auto it = names->find(std::string(name));
+        return it == names->end() ? nullptr : it->second->program.load();
+    }
+
+    // Atomically replaces (or creates) `name`. Readers already running the old
+    // version finish on it; the old version is freed after they are done.
+    void publish(const std::string& name, std::unique_ptr<const T> program) {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        Slot* slot = slot_for(name);
+        const T* old = slot->program.exchange(program.release());
+        if (old) m_domain.retire([old] { delete old; });
+    }
+
+    // Unpublishes `name`; returns false if it was not published.
+    bool remove(const std::string& name) {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        auto it = m_names.load()->find(name);
+        if (it == m_names.load()->end()) return false;
+        const T* old = it->second->program.exchange(nullptr);
+        if (old) m_domain.retire([old] { delete old; });
+        return old != nullptr;
+    }
+
+private:
+    struct Slot {
+        std::atomic<const T*> program{nullptr};
+    };
+    using Name_map = std::unordered_map<std::string, Slot*>;
+
+    Epoch_domain& m_domain;
+    std::atomic<const Name_map*> m_names;
+    std::vector<std::unique_ptr<Slot>> m_slots;
+    std::mutex m_write_mutex;
+
+    // Adding a name copies the table and publishes the copy (copy-on-write).
+    Slot* slot_for(const std::string& name) {
+        const Name_map* names = m_names.load();
+        auto it = names->find(name);
+        if (it != names->end()) return it->second;
+
+        m_slots.push_back(std::make_unique<Slot>());
+        auto* grown = new Name_map(*names);
+        (*grown)[name] = m_slots.back().get();
+        m_names.store(grown);
+        m_domain.retire([names] { delete names; });
+        return m_slots.back().get();
+    }
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// =======================================================================
+// ==            SCRIPT BUNDLE (Single File, mmap-able Index)           ==
+// =======================================================================
+// Packs many scripts into one file so a driver can reach any of them with
+// one open and one mmap, instead of an inode lookup and a read per script.
+//
+// Layout (host byte order; every offset is from the start of the file):
+//
+//   Header           64 bytes, see Bundle_header
+//   Index            entry_count x Bundle_index_entry, sorted by name
+//   Names            the entry names, back to back
+//   Data sections    each source, and its optional pre-lexed token stream,
+//                    starting on a 64-byte boundary
+//
+// The token stream is opaque here: the compiler that wrote it defines the
+// encoding and stamps its version into `token_format`, so a reader built
+// with a different token set can tell the streams are stale and re-lex.
+
+struct Bundle_header {
+    char magic[8];          // "SIMPLBND"
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t token_format;  // 0 = no token streams
+    uint32_t reserved;
+    uint64_t index_offset;
+    uint64_t names_offset;
+    uint64_t file_size;
+    uint64_t padding[2];
+};
+static_assert(sizeof(Bundle_header) == 64, "Bundle header must stay 64 bytes.");
+
+struct Bundle_index_entry {
+    uint64_t name_offset;
+    uint64_t source_offset;
+    uint64_t source_length;
+    uint64_t tokens_offset;
+    uint64_t tokens_length; // 0 = this entry has no token stream
+    uint32_t name_length;
+    uint32_t reserved;
+};
+static_assert(sizeof(Bundle_index_entry) == 48, "Bundle index entries must stay 48 bytes.");
+
+constexpr char BUNDLE_MAGIC[8] = {'S', 'I', 'M', 'P', 'L', 'B', 'N', 'D'};
+constexpr uint32_t BUNDLE_VERSION = 1;
+constexpr uint64_t BUNDLE_ALIGNMENT = 64;
+
+struct Bundle_entry {
+    std::string_view name;
+    std::string_view source;
+    std::string_view tokens; // Empty if the bundle carries no token stream for it
+};
+
+class Bundle_writer {
+public:
+    explicit Bundle_writer(uint32_t token_format = 0) : m_token_format(token_format) {}
+
+    void add(std::string name, std::string source, std::string tokens = {}) {
+        m_entries.push_back({std::move(name), std::move(source), std::move(tokens)});
+    }
+
+    void write(const std::string& path) {
+        std::sort(m_entries.begin(), m_entries.end(), [](const Pending& a, const Pending& b) { return a.name < b.name; });
+        for (size_t i = 1; i < m_entries.size(); i++) {
+            if (m_entries[i].name == m_entries[i - 1].name) {
+                throw std::runtime_error("Duplicate script name in bundle: " + m_entries[i].name);
+            }
+        }
+
+        Bundle_header header{};
+        std::memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+        header.version = BUNDLE_VERSION;
+        header.entry_count = static_cast<uint32_t>(m_entries.size());
+        header.token_format = m_token_format;
+        header.index_offset = sizeof(Bundle_header);
+        header.names_offset = header.index_offset + m_entries.size() * sizeof(Bundle_index_entry);
+
+        std::vector<Bundle_index_entry> index(m_entries.size());
+        uint64_t offset = header.names_offset;
+        for (size_t i = 0; i < m_entries.size(); i++) {
+            index[i].name_offset = offset;
+            index[i].name_length = static_cast<uint32_t>(m_entries[i].name.size());
+            offset += m_entries[i].name.size();
+        }
+        for (size_t i = 0; i < m_entries.size(); i++) {
+            offset = align(offset);
+            index[i].source_offset = offset;
+            index[i].source_length = m_entries[i].source.size();
+            offset += m_entries[i].source.size();
+            if (!m_entries[i].tokens.empty()) {
+                offset = align(offset);
+                index[i].tokens_offset = offset;
+                index[i].tokens_length = m_entries[i].tokens.size();
+                offset += m_entries[i].tokens.size();
+            }
+        }
+        header.file_size = offset;
+
+        // Written to a temporary and renamed, so readers never map a half-written bundle.
+        std::string temp = path + ".tmp";
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            if (!out) throw std::runtime_error("Cannot create bundle: " + temp);
+            uint64_t written = 0;
+            auto put = [&](const void* data, size_t size) {
+                out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+                written += size;
+            };
+            auto pad_to = [&](uint64_t target) {
+                static const char zeros[BUNDLE_ALIGNMENT] = {};
+                while (written < target) put(zeros, std::min<uint64_t>(target - written, BUNDLE_ALIGNMENT));
+            };
+            put(&header, sizeof(header));
+            put(index.data(), index.size() * sizeof(Bundle_index_entry));
+            for (const auto& e : m_entries) put(e.name.data(), e.name.size());
+            for (size_t i = 0; i < m_entries.size(); i++) {
+                pad_to(index[i].source_offset);
+                put(m_entries[i].source.data(), m_entries[i].source.size());
+                if (index[i].tokens_length) {
+                    pad_to(index[i].tokens_offset);
+                    put(m_entries[i].tokens.data(), m_entries[i].tokens.size());
+                }
+            }
+            if (!out.flush()) throw std::runtime_error("Cannot write bundle: " + temp);
+        }
+        if (std::rename(temp.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Cannot rename bundle into place: " + path);
+        }
+    }
+
+private:
+    struct Pending {
+        std::string name;
+        std::string source;
+        std::string tokens;
+    };
+    uint32_t m_token_format;
+    std::vector<Pending> m_entries;
+
+    static uint64_t align(uint64_t offset) { return (offset + BUNDLE_ALIGNMENT - 1) & ~(BUNDLE_ALIGNMENT - 1); }
+};
+
+// A read-only view of a bundle. Opening costs one open, fstat and mmap; all
+// lookups after that are a binary search over the mapped index.
+class Bundle_reader {
+public:
+    explicit Bundle_reader(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw std::runtime_error("Cannot open bundle " + path + ": " + std::strerror(errno));
+        struct stat st {};
+        if (::fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(Bundle_header))) {
+            ::close(fd);
+            throw std::runtime_error("Not a script bundle: " + path);
+        }
+        m_size = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // The mapping keeps the file alive
+        if (p == MAP_FAILED) throw std::runtime_error("Cannot map bundle " + path + ": " + std::strerror(errno));
+        m_base = static_cast<const char*>(p);
+        try {
+            validate(path);
+        } catch (...) {
+            ::munmap(const_cast<char*>(m_base), m_size);
+            throw;
+        }
+    }
+
+    ~Bundle_reader() { ::munmap(const_cast<char*>(m_base), m_size); }
+
+    Bundle_reader(const Bundle_reader&) = delete;
+    Bundle_reader& operator=(const Bundle_reader&) = delete;
+
+    uint32_t token_format() const { return header().token_format; }
+    size_t size() const { return header().entry_count; }
+
+    Bundle_entry at(size_t i) const {
+        const Bundle_index_entry& e = index()[i];
+        return {
+            {m_base + e.name_offset, e.name_length},
+            {m_base + e.source_offset, static_cast<size_t>(e.source_length)},
+            {e.tokens_length ? m_base + e.tokens_offset : nullptr, static_cast<size_t>(e.tokens_length)},
+        };
+    }
+
+    std::optional<Bundle_entry> find(std::string_view name) const {
+        const Bundle_index_entry* first = index();
+        const Bundle_index_entry* last = first + size();
+        auto it = std::lower_bound(first, last, name, [this](const Bundle_index_entry& e, std::string_view key) {
+            return std::string_view(m_base + e.name_offset, e.name_length) < key;
+        });
+        if (it == last || std::string_view(m_base + it->name_offset, it->name_length) != name) return std::nullopt;
+        return at(static_cast<size_t>(it - first));
+    }
+
+private:
+    const char* m_base = nullptr;
+    size_t m_size = 0;
+
+    const Bundle_header& header() const { return *reinterpret_cast<const Bundle_header*>(m_base); }
+    const Bundle_index_entry* index() const {
+        return reinterpret_cast<const Bundle_index_entry*>(m_base + header().index_offset);
+    }
+
+    // Checks every offset once up front so lookups never need bounds checks.
+    void validate(const std::string& path) const {
+        const Bundle_header& h = header();
+        auto in_file = [&](uint64_t offset, uint64_t length) {
+            return offset <= m_size && length <= m_size - offset;
+        };
+        if (std::memcmp(h.magic, BUNDLE_MAGIC, sizeof(h.magic)) != 0 || h.version != BUNDLE_VERSION ||
+            h.file_size != m_size || h.index_offset % alignof(Bundle_index_entry) != 0 ||
+            !in_file(h.index_offset, uint64_t(h.entry_count) * sizeof(Bundle_index_entry))) {
+            throw std::runtime_error("Not a valid script bundle: " + path);
+        }
+        for (size_t i = 0; i < h.entry_count; i++) {
+            const Bundle_index_entry& e = index()[i];
+            if (!in_file(e.name_offset, e.name_length) || !in_file(e.source_offset, e.source_length) ||
+                !in_file(e.tokens_offset, e.tokens_length)) {
+                throw std::runtime_error("Corrupt script bundle entry in " + path);
+            }
+        }
+    }
+};
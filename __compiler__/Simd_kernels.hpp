@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)) // 32-bit x86 need not have SSE2
+#include <immintrin.h>
+#define SIMPL_HAVE_X86_SIMD 1
+#define SIMPL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// =======================================================================
+// ==         SIMD KERNELS FOR ELEMENT-WISE ARRAY OPERATIONS            ==
+// =======================================================================
+// The interpreter hands whole arrays to these loops instead of touching one
+// element at a time. Each operator is a template instantiated for AVX2
+// (4 doubles per step) and SSE2 (2 doubles per step), picked once at runtime
+// from the CPU's feature flags, with a scalar loop for the tail and for
+// non-x86 builds. Comparisons produce 1.0 / 0.0 like the scalar interpreter.
+
+enum class Simd_op { ADD, SUB, MUL, DIV, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, EQUAL, NOT_EQUAL };
+
+namespace simd_detail {
+
+template <Simd_op Op>
+inline double apply_scalar(double a, double b) {
+    if constexpr (Op == Simd_op::ADD)           return a + b;
+    if constexpr (Op == Simd_op::SUB)           return a - b;
+    if constexpr (Op == Simd_op::MUL)           return a * b;
+    if constexpr (Op == Simd_op::DIV)           return a / b;
+    if constexpr (Op == Simd_op::LESS)          return a < b;
+    if constexpr (Op == Simd_op::LESS_EQUAL)    return a <= b;
+    if constexpr (Op == Simd_op::GREATER)       return a > b;
+    if constexpr (Op == Simd_op::GREATER_EQUAL) return a >= b;
+    if constexpr (Op == Simd_op::EQUAL)         return a == b;
+    if constexpr (Op == Simd_op::NOT_EQUAL)     return a != b;
+}
+
+// A_scalar / B_scalar broadcast a single value against the other array.
+template <Simd_op Op, bool A_scalar, bool B_scalar>
+inline void scalar_loop(const double* a, const double* b, double* out, std::size_t from, std::size_t n) {
+    for (std::size_t i = from; i < n; i++) {
+        out[i] = apply_scalar<Op>(A_scalar ? a[0] : a[i], B_scalar ? b[0] : b[i]);
+    }
+}
+
+// Folds a[from..n) into `best`. Any NaN makes the result NaN, whichever
+// path runs.
+template <bool Is_min>
+inline double scalar_min_max(const double* a, std::size_t from, std::size_t n, double best) {
+    for (std::size_t i = from; i < n; i++) {
+        if (std::isnan(a[i])) return a[i];
+        best = Is_min ? std::min(best, a[i]) : std::max(best, a[i]);
+    }
+    return best;
+}
+
+#ifdef SIMPL_HAVE_X86_SIMD
+
+template <Simd_op Op>
+inline __m128d apply_sse(__m128d a, __m128d b) {
+    const __m128d one = _mm_set1_pd(1.0);
+    if constexpr (Op == Simd_op::ADD)           return _mm_add_pd(a, b);
+    if constexpr (Op == Simd_op::SUB)           return _mm_sub_pd(a, b);
+    if constexpr (Op == Simd_op::MUL)           return _mm_mul_pd(a, b);
+    if constexpr (Op == Simd_op::DIV)           return _mm_div_pd(a, b);
+    if constexpr (Op == Simd_op::LESS)          return _mm_and_pd(_mm_cmplt_pd(a, b), one);
+    if constexpr (Op == Simd_op::LESS_EQUAL)    return _mm_and_pd(_mm_cmple_pd(a, b), one);
+    if constexpr (Op == Simd_op::GREATER)       return _mm_and_pd(_mm_cmpgt_pd(a, b), one);
+    if constexpr (Op == Simd_op::GREATER_EQUAL) return _mm_and_pd(_mm_cmpge_pd(a, b), one);
+    if constexpr (Op == Simd_op::EQUAL)         return _mm_and_pd(_mm_cmpeq_pd(a, b), one);
+    if constexpr (Op == Simd_op::NOT_EQUAL)     return _mm_and_pd(_mm_cmpneq_pd(a, b), one);
+}
+
+template <Simd_op Op, bool A_scalar, bool B_scalar>
+inline void sse_loop(const double* a, const double* b, double* out, std::size_t n) {
+    const __m128d a_splat = _mm_set1_pd(A_scalar ? a[0] : 0.0); // Only a scalar side is read here
+    const __m128d b_splat = _mm_set1_pd(B_scalar ? b[0] : 0.0);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d va = A_scalar ? a_splat : _mm_loadu_pd(a + i);
+        __m128d vb = B_scalar ? b_splat : _mm_loadu_pd(b + i);
+        _mm_storeu_pd(out + i, apply_sse<Op>(va, vb));
+    }
+    scalar_loop<Op, A_scalar, B_scalar>(a, b, out, i, n);
+}
+
+template <Simd_op Op>
+SIMPL_TARGET_AVX2 inline __m256d apply_avx(__m256d a, __m256d b) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    if constexpr (Op == Simd_op::ADD)           return _mm256_add_pd(a, b);
+    if constexpr (Op == Simd_op::SUB)           return _mm256_sub_pd(a, b);
+    if constexpr (Op == Simd_op::MUL)           return _mm256_mul_pd(a, b);
+    if constexpr (Op == Simd_op::DIV)           return _mm256_div_pd(a, b);
+    if constexpr (Op == Simd_op::LESS)          return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ), one);
+    if constexpr (Op == Simd_op::LESS_EQUAL)    return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ), one);
+    if constexpr (Op == Simd_op::GREATER)       return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ), one);
+    if constexpr (Op == Simd_op::GREATER_EQUAL) return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ), one);
+    if constexpr (Op == Simd_op::EQUAL)         return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ), one);
+    if constexpr (Op == Simd_op::NOT_EQUAL)     return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_NEQ_UQ), one);
+}
+
+template <Simd_op Op, bool A_scalar, bool B_scalar>
+SIMPL_TARGET_AVX2 void avx_loop(const double* a, const double* b, double* out, std::size_t n) {
+    const __m256d a_splat = _mm256_set1_pd(A_scalar ? a[0] : 0.0); // Only a scalar side is read here
+    const __m256d b_splat = _mm256_set1_pd(B_scalar ? b[0] : 0.0);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d va = A_scalar ? a_splat : _mm256_loadu_pd(a + i);
+        __m256d vb = B_scalar ? b_splat : _mm256_loadu_pd(b + i);
+        _mm256_storeu_pd(out + i, apply_avx<Op>(va, vb));
+    }
+    scalar_loop<Op, A_scalar, B_scalar>(a, b, out, i, n);
+}
+
+SIMPL_TARGET_AVX2 inline double avx_sum(const double* a, std::size_t n) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(a + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(a + i + 4));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) total += a[i];
+    return total;
+}
+
+// vminpd/vmaxpd return their second operand when either is NaN, so NaNs
+// are tracked in a mask of their own and the result made NaN at the end.
+template <bool Is_min>
+SIMPL_TARGET_AVX2 double avx_min_max(const double* a, std::size_t n) {
+    __m256d acc = _mm256_set1_pd(a[0]);
+    __m256d nan = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_loadu_pd(a + i);
+        nan = _mm256_or_pd(nan, _mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+        acc = Is_min ? _mm256_min_pd(acc, v) : _mm256_max_pd(acc, v);
+    }
+    if (_mm256_movemask_pd(nan)) return std::numeric_limits<double>::quiet_NaN();
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    double best = lanes[0];
+    for (int k = 1; k < 4; k++) best = Is_min ? std::min(best, lanes[k]) : std::max(best, lanes[k]);
+    return scalar_min_max<Is_min>(a, i, n, best);
+}
+
+inline bool cpu_has_avx2() {
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+}
+
+#endif // SIMPL_HAVE_X86_SIMD
+
+template <Simd_op Op, bool A_scalar, bool B_scalar>
+void run(const double* a, const double* b, double* out, std::size_t n) {
+    if (n == 0) return; // An empty array's data() may be null
+#ifdef SIMPL_HAVE_X86_SIMD
+    if (cpu_has_avx2()) { avx_loop<Op, A_scalar, B_scalar>(a, b, out, n); return; }
+    sse_loop<Op, A_scalar, B_scalar>(a, b, out, n);
+#else
+    scalar_loop<Op, A_scalar, B_scalar>(a, b, out, 0, n);
+#endif
+}
+
+template <Simd_op Op>
+void run_shape(const double* a, bool a_scalar, const double* b, bool b_scalar, double* out, std::size_t n) {
+    if (a_scalar)      run<Op, true, false>(a, b, out, n);
+    else if (b_scalar) run<Op, false, true>(a, b, out, n);
+    else               run<Op, false, false>(a, b, out, n);
+}
+
+} // namespace simd_detail
+
+// out[i] = a[i] op b[i] for i < n. Set a_scalar or b_scalar (not both) to
+// broadcast a single value; `out` may alias either input.
+inline void simd_binary(Simd_op op, const double* a, bool a_scalar, const double* b, bool b_scalar,
+                        double* out, std::size_t n) {
+    using namespace simd_detail;
+    switch (op) {
+        case Simd_op::ADD:           run_shape<Simd_op::ADD>(a, a_scalar, b, b_scalar, out, n); break;
+        case Simd_op::SUB:           run_shape<Simd_op::SUB>(a, a_scalar, b, b_scalar, out, n); break;
+        case Simd_op::MUL:           run_shape<Simd_op::MUL>(a, a_scalar, b, b_scalar, out, n); break;
+        case Simd_op::DIV:           run_shape<Simd_op::DIV>(a, a_scalar, b, b_scalar, out, n); break;
+        case Simd_op::LESS:          run_shape<Simd_op::LESS>(a, a_scalar, b, b_scalar, out, n); break;
+        case Simd_op::LESS_EQUAL:    run_shape<Simd_op::LESS_EQUAL>(a, a_scalar, b, b_scalar, out, n); break;
+        case Simd_op::GREATER:       run_shape<Simd_op::GREATER>(a, a_scalar, b, b_scalar, out, n); break;
+        case Simd_op::GREATER_EQUAL: run_shape<Simd_op::GREATER_EQUAL>(a, a_scalar, b, b_scalar, out, n); break;
+        case Simd_op::EQUAL:         run_shape<Simd_op::EQUAL>(a, a_scalar, b, b_scalar, out, n); break;
+        case Simd_op::NOT_EQUAL:     run_shape<Simd_op::NOT_EQUAL>(a, a_scalar, b, b_scalar, out, n); break;
+    }
+}
+
+// Sum of a[0..n). Lanes are added pairwise, so the rounding differs slightly
+// from a left-to-right scalar loop.
+inline double simd_sum(const double* a, std::size_t n) {
+#ifdef SIMPL_HAVE_X86_SIMD
+    if (simd_detail::cpu_has_avx2()) return simd_detail::avx_sum(a, n);
+#endif
+    double total = 0.0;
+    for (std::size_t i = 0; i < n; i++) total += a[i];
+    return total;
+}
+
+// Smallest / largest of a[0..n); n must be at least 1. NaN if any element
+// is NaN.
+inline double simd_min(const double* a, std::size_t n) {
+#ifdef SIMPL_HAVE_X86_SIMD
+    if (simd_detail::cpu_has_avx2()) return simd_detail::avx_min_max<true>(a, n);
+#endif
+    return simd_detail::scalar_min_max<true>(a, 0, n, a[0]);
+}
+
+inline double simd_max(const double* a, std::size_t n) {
+#ifdef SIMPL_HAVE_X86_SIMD
+    if (simd_detail::cpu_has_avx2()) return simd_detail::avx_min_max<false>(a, n);
+#endif
+    return simd_detail::scalar_min_max<false>(a, 0, n, a[0]);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "Simd_kernels.hpp"
+
+// =======================================================================
+// ==              SIMD BYTE SCANNING FOR THE LEXERS                    ==
+// =======================================================================
+// Lexing mostly means looking for a handful of byte values in long runs of
+// text. These loops compare 32 bytes (AVX2) or 16 bytes (SSE2) at a time and
+// turn the matches into a bit mask, so the caller only sees the positions that
+// matter. The AVX2 path is picked at runtime like the array kernels.
+
+namespace scan_detail {
+
+template <typename Fn>
+inline void each_bit(uint32_t mask, size_t base, Fn& fn) {
+    while (mask) {
+        fn(base + static_cast<size_t>(__builtin_ctz(mask)));
+        mask &= mask - 1;
+    }
+}
+
+#ifdef SIMPL_HAVE_X86_SIMD
+
+template <typename Fn>
+inline size_t sse_for_each(const char* data, size_t n, char byte, Fn& fn) {
+    const __m128i needle = _mm_set1_epi8(byte);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        each_bit(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle))), i, fn);
+    }
+    return i;
+}
+
+template <typename Fn>
+SIMPL_TARGET_AVX2 size_t avx_for_each(const char* data, size_t n, char byte, Fn& fn) {
+    const __m256i needle = _mm256_set1_epi8(byte);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        each_bit(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle))), i, fn);
+    }
+    return i;
+}
+
+inline size_t sse_find_either(const char* data, size_t from, size_t n, char a, char b) {
+    const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b);
+    size_t i = from;
+    for (; i + 16 <= n; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)));
+        if (mask) return i + static_cast<size_t>(__builtin_ctz(static_cast<uint32_t>(mask)));
+    }
+    return i;
+}
+
+SIMPL_TARGET_AVX2 inline size_t avx_find_either(const char* data, size_t from, size_t n, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b);
+    size_t i = from;
+    for (; i + 32 <= n; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, va), _mm256_cmpeq_epi8(chunk, vb))));
+        if (mask) return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+    return i;
+}
+
+inline size_t sse_skip_ascii(const char* data, size_t from, size_t n) {
+    size_t i = from;
+    for (; i + 16 <= n; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+        if (mask) return i + static_cast<size_t>(__builtin_ctz(static_cast<uint32_t>(mask)));
+    }
+    return i;
+}
+
+SIMPL_TARGET_AVX2 inline size_t avx_skip_ascii(const char* data, size_t from, size_t n) {
+    size_t i = from;
+    for (; i + 32 <= n; i += 32) {
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i))));
+        if (mask) return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+    return i;
+}
+
+#endif // SIMPL_HAVE_X86_SIMD
+
+} // namespace scan_detail
+
+// Calls fn(offset) for every occurrence of `byte` in `text`, in order.
+template <typename Fn>
+void simd_for_each_byte(std::string_view text, char byte, Fn&& fn) {
+    size_t i = 0;
+#ifdef SIMPL_HAVE_X86_SIMD
+    i = simd_detail::cpu_has_avx2() ? scan_detail::avx_for_each(text.data(), text.size(), byte, fn)
+                                    : scan_detail::sse_for_each(text.data(), text.size(), byte, fn);
+#endif
+    for (; i < text.size(); i++) {
+        if (text[i] == byte) fn(i);
+    }
+}
+
+// Offset of the first `a` or `b` at or after `from`, or text.size() if none.
+inline size_t simd_find_either(std::string_view text, size_t from, char a, char b) {
+    size_t i = from;
+#ifdef SIMPL_HAVE_X86_SIMD
+    i = simd_detail::cpu_has_avx2() ? scan_detail::avx_find_either(text.data(), from, text.size(), a, b)
+                                    : scan_detail::sse_find_either(text.data(), from, text.size(), a, b);
+#endif
+    for (; i < text.size(); i++) {
+        if (text[i] == a || text[i] == b) return i;
+    }
+    return text.size();
+}
+
+// Offset of the first byte at or after `from` with its high bit set (that
+// is, not ASCII), or text.size() if none.
+inline size_t simd_skip_ascii(std::string_view text, size_t from) {
+    size_t i = from;
+#ifdef SIMPL_HAVE_X86_SIMD
+    i = simd_detail::cpu_has_avx2() ? scan_detail::avx_skip_ascii(text.data(), from, text.size())
+                                    : scan_detail::sse_skip_ascii(text.data(), from, text.size());
+#endif
+    for (; i < text.size(); i++) {
+        if (static_cast<unsigned char>(text[i]) >= 0x80) return i;
+    }
+    return text.size();
+}
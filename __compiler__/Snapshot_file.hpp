@@ -0,0 +1,240 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// =======================================================================
+// ==        INTERPRETER SNAPSHOT (Slots and Values, mmap-able)         ==
+// =======================================================================
+// Saves the variables a program left behind, so that a process that would
+// otherwise recompute them on every start can map them back instead.
+//
+// Layout (host byte order; every offset is from the start of the file, so
+// the file can be mapped at any address):
+//
+//   Header           64 bytes, see Snapshot_header
+//   Slots            slot_count x Snapshot_slot_entry, in slot order
+//   Names            the slot names, back to back
+//   Program          the source of the program that produced the values
+//   Data sections    each array's doubles, or each string's bytes, starting
+//                    on a 64-byte boundary
+//
+// Slots are stored in slot order, so resolving the names in order in a new
+// Slot_table gives every variable its old slot. The program source tells a
+// reader whether the snapshot is still current for the program it has.
+
+struct Snapshot_header {
+    char magic[8];          // "SIMPLSNP"
+    uint32_t version;
+    uint32_t slot_count;
+    uint64_t slots_offset;
+    uint64_t names_offset;
+    uint64_t program_offset;
+    uint64_t program_length;
+    uint64_t file_size;
+    uint64_t padding;
+};
+static_assert(sizeof(Snapshot_header) == 64, "Snapshot header must stay 64 bytes.");
+
+enum class Snapshot_kind : uint32_t { UNDEFINED, NUMBER, ARRAY, STRING };
+
+struct Snapshot_slot_entry {
+    uint64_t name_offset;
+    uint64_t data_offset;   // ARRAY and STRING only
+    uint64_t data_length;   // Bytes
+    double number;          // NUMBER only
+    uint32_t name_length;
+    Snapshot_kind kind;
+};
+static_assert(sizeof(Snapshot_slot_entry) == 40, "Snapshot slot entries must stay 40 bytes.");
+
+constexpr char SNAPSHOT_MAGIC[8] = {'S', 'I', 'M', 'P', 'L', 'S', 'N', 'P'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+constexpr uint64_t SNAPSHOT_ALIGNMENT = 64;
+
+struct Snapshot_slot {
+    std::string_view name;
+    Snapshot_kind kind;
+    double number;
+    const double* elements; // ARRAY: `count` doubles in the mapping
+    size_t count;
+    std::string_view text;  // STRING
+};
+
+class Snapshot_writer {
+public:
+    explicit Snapshot_writer(std::string program) : m_program(std::move(program)) {}
+
+    void add_undefined(std::string name) { m_slots.push_back({std::move(name), Snapshot_kind::UNDEFINED, 0, {}}); }
+    void add_number(std::string name, double n) { m_slots.push_back({std::move(name), Snapshot_kind::NUMBER, n, {}}); }
+    void add_array(std::string name, const double* elements, size_t count) {
+        std::string data(reinterpret_cast<const char*>(elements), count * sizeof(double));
+        m_slots.push_back({std::move(name), Snapshot_kind::ARRAY, 0, std::move(data)});
+    }
+    void add_string(std::string name, std::string text) {
+        m_slots.push_back({std::move(name), Snapshot_kind::STRING, 0, std::move(text)});
+    }
+
+    void write(const std::string& path) const {
+        Snapshot_header header{};
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.slot_count = static_cast<uint32_t>(m_slots.size());
+        header.slots_offset = sizeof(Snapshot_header);
+        header.names_offset = header.slots_offset + m_slots.size() * sizeof(Snapshot_slot_entry);
+
+        std::vector<Snapshot_slot_entry> entries(m_slots.size());
+        uint64_t offset = header.names_offset;
+        for (size_t i = 0; i < m_slots.size(); i++) {
+            entries[i].name_offset = offset;
+            entries[i].name_length = static_cast<uint32_t>(m_slots[i].name.size());
+            entries[i].kind = m_slots[i].kind;
+            entries[i].number = m_slots[i].number;
+            offset += m_slots[i].name.size();
+        }
+        header.program_offset = offset;
+        header.program_length = m_program.size();
+        offset += m_program.size();
+        for (size_t i = 0; i < m_slots.size(); i++) {
+            if (m_slots[i].data.empty()) continue;
+            offset = align(offset);
+            entries[i].data_offset = offset;
+            entries[i].data_length = m_slots[i].data.size();
+            offset += m_slots[i].data.size();
+        }
+        header.file_size = offset;
+
+        // Written to a temporary and renamed, so readers never map a half-written snapshot.
+        std::string temp = path + ".tmp";
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            if (!out) throw std::runtime_error("Cannot create snapshot: " + temp);
+            uint64_t written = 0;
+            auto put = [&](const void* data, size_t size) {
+                out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+                written += size;
+            };
+            put(&header, sizeof(header));
+            put(entries.data(), entries.size() * sizeof(Snapshot_slot_entry));
+            for (const auto& s : m_slots) put(s.name.data(), s.name.size());
+            put(m_program.data(), m_program.size());
+            for (size_t i = 0; i < m_slots.size(); i++) {
+                if (m_slots[i].data.empty()) continue;
+                static const char zeros[SNAPSHOT_ALIGNMENT] = {};
+                put(zeros, entries[i].data_offset - written);
+                put(m_slots[i].data.data(), m_slots[i].data.size());
+            }
+            if (!out.flush()) throw std::runtime_error("Cannot write snapshot: " + temp);
+        }
+        if (std::rename(temp.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Cannot rename snapshot into place: " + path);
+        }
+    }
+
+private:
+    struct Pending {
+        std::string name;
+        Snapshot_kind kind;
+        double number;
+        std::string data;
+    };
+    std::string m_program;
+    std::vector<Pending> m_slots;
+
+    static uint64_t align(uint64_t offset) { return (offset + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1); }
+};
+
+// A read-only view of a snapshot. Opening costs one open, fstat and mmap;
+// the values are paged in as they are read.
+class Snapshot_reader {
+public:
+    explicit Snapshot_reader(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw std::runtime_error("Cannot open snapshot " + path + ": " + std::strerror(errno));
+        struct stat st {};
+        if (::fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(Snapshot_header))) {
+            ::close(fd);
+            throw std::runtime_error("Not an interpreter snapshot: " + path);
+        }
+        m_size = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // The mapping keeps the file alive
+        if (p == MAP_FAILED) throw std::runtime_error("Cannot map snapshot " + path + ": " + std::strerror(errno));
+        m_base = static_cast<const char*>(p);
+        try {
+            validate(path);
+        } catch (...) {
+            ::munmap(const_cast<char*>(m_base), m_size);
+            throw;
+        }
+        ::madvise(const_cast<char*>(m_base), m_size, MADV_SEQUENTIAL); // Restoring reads it front to back
+    }
+
+    ~Snapshot_reader() { ::munmap(const_cast<char*>(m_base), m_size); }
+
+    Snapshot_reader(const Snapshot_reader&) = delete;
+    Snapshot_reader& operator=(const Snapshot_reader&) = delete;
+
+    std::string_view program() const {
+        return {m_base + header().program_offset, static_cast<size_t>(header().program_length)};
+    }
+    size_t size() const { return header().slot_count; }
+
+    Snapshot_slot at(size_t i) const {
+        const Snapshot_slot_entry& e = slots()[i];
+        Snapshot_slot slot{{m_base + e.name_offset, e.name_length}, e.kind, e.number, nullptr, 0, {}};
+        if (e.kind == Snapshot_kind::ARRAY) {
+            slot.elements = reinterpret_cast<const double*>(m_base + e.data_offset);
+            slot.count = static_cast<size_t>(e.data_length / sizeof(double));
+        } else if (e.kind == Snapshot_kind::STRING) {
+            slot.text = {m_base + e.data_offset, static_cast<size_t>(e.data_length)};
+        }
+        return slot;
+    }
+
+private:
+    const char* m_base = nullptr;
+    size_t m_size = 0;
+
+    const Snapshot_header& header() const { return *reinterpret_cast<const Snapshot_header*>(m_base); }
+    const Snapshot_slot_entry* slots() const {
+        return reinterpret_cast<const Snapshot_slot_entry*>(m_base + header().slots_offset);
+    }
+
+    // Checks every offset once up front so reads never need bounds checks.
+    void validate(const std::string& path) const {
+        const Snapshot_header& h = header();
+        auto in_file = [&](uint64_t offset, uint64_t length) {
+            return offset <= m_size && length <= m_size - offset;
+        };
+        if (std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 || h.version != SNAPSHOT_VERSION ||
+            h.file_size != m_size || h.slots_offset % alignof(Snapshot_slot_entry) != 0 ||
+            !in_file(h.slots_offset, uint64_t(h.slot_count) * sizeof(Snapshot_slot_entry)) ||
+            !in_file(h.program_offset, h.program_length)) {
+            throw std::runtime_error("Not a valid interpreter snapshot: " + path);
+        }
+        for (size_t i = 0; i < h.slot_count; i++) {
+            const Snapshot_slot_entry& e = slots()[i];
+            bool data_ok = e.kind == Snapshot_kind::STRING ||
+                           (e.kind == Snapshot_kind::ARRAY && e.data_offset % alignof(double) == 0 &&
+                            e.data_length % sizeof(double) == 0) ||
+                           e.data_length == 0;
+            if (e.kind > Snapshot_kind::STRING || !data_ok || !in_file(e.name_offset, e.name_length) ||
+                !in_file(e.data_offset, e.data_length)) {
+                throw std::runtime_error("Corrupt interpreter snapshot entry in " + path);
+            }
+        }
+    }
+};
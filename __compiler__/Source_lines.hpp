@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Simd_scan.hpp"
+
+// =======================================================================
+// ==              SOURCE LOCATIONS (Offsets -> Line:Column)            ==
+// =======================================================================
+// Tokens only carry the byte offset where they start, so the lexers never
+// count lines. When a diagnostic needs a line and column, Source_lines finds
+// every newline once with a SIMD scan and answers each lookup with a binary
+// search. Programs that never report a location never pay for the table.
+
+struct Source_location {
+    uint32_t line;   // 1-based
+    uint32_t column; // 1-based, in bytes
+};
+
+class Source_lines {
+public:
+    // `source` must outlive this object.
+    explicit Source_lines(std::string_view source) : m_source(source) {}
+
+    Source_lines(const Source_lines&) = delete;
+    Source_lines& operator=(const Source_lines&) = delete;
+
+    // Safe to call from several threads; the first call builds the table.
+    Source_location locate(uint32_t offset) const {
+        std::call_once(m_built, [this] { build(); });
+        // The last line starting at or before `offset`.
+        auto it = std::upper_bound(m_line_starts.begin(), m_line_starts.end(), offset);
+        uint32_t line = static_cast<uint32_t>(it - m_line_starts.begin());
+        return {line, offset - m_line_starts[line - 1] + 1};
+    }
+
+    // "line:column", the form the diagnostics print.
+    std::string describe(uint32_t offset) const {
+        Source_location at = locate(offset);
+        return std::to_string(at.line) + ":" + std::to_string(at.column);
+    }
+
+    // How many lines there are; the last may be empty.
+    uint32_t line_count() const {
+        std::call_once(m_built, [this] { build(); });
+        return static_cast<uint32_t>(m_line_starts.size());
+    }
+
+    // The text of line `number` (1-based), without its line break.
+    std::string_view line_text(uint32_t number) const {
+        std::call_once(m_built, [this] { build(); });
+        if (number == 0 || number > m_line_starts.size()) return {};
+        size_t begin = m_line_starts[number - 1];
+        size_t end = number < m_line_starts.size() ? m_line_starts[number] - 1 : m_source.size();
+        std::string_view text = m_source.substr(begin, end - begin);
+        if (!text.empty() && text.back() == '\r') text.remove_suffix(1);
+        return text;
+    }
+
+private:
+    std::string_view m_source;
+    mutable std::once_flag m_built;
+    mutable std::vector<uint32_t> m_line_starts;
+
+    void build() const {
+        m_line_starts.push_back(0);
+        simd_for_each_byte(m_source, '\n', [this](size_t i) { m_line_starts.push_back(static_cast<uint32_t>(i + 1)); });
+    }
+};
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+
+// =======================================================================
+// ==        COMPILE-TIME SimPL EXPRESSIONS (C++20)                     ==
+// =======================================================================
+// A constexpr copy of the expression half of the SimPL front end. A string
+// literal is lexed and parsed while the C++ compiler runs, and the resulting
+// tree is turned into a nested expression-template type, so evaluating it is
+// just a handful of inlined arithmetic instructions:
+//
+//     constexpr auto f = simpl::compile<"a * 2 + (a / b)">();
+//     double r = f(10.0, 5.0);   // variables bind in order of first use
+//
+// Only expressions are supported (no statements, no assignment), matching the
+// grammar of Parser::equality() and below. A syntax error in the literal
+// becomes a compile error pointing at the failing throw. Number literals are
+// limited to 2^53 (9007199254740992): up to there the digit-by-digit value
+// is exact, so it is the same double strtod() gives the interpreter, and a
+// longer literal is a compile error rather than a differently rounded one.
+
+namespace simpl {
+
+// A string literal usable as a template argument.
+template <std::size_t N>
+struct Fixed_string {
+    char data[N]{};
+    constexpr Fixed_string(const char (&str)[N]) {
+        for (std::size_t i = 0; i < N; i++) data[i] = str[i];
+    }
+    constexpr std::string_view view() const { return {data, N - 1}; }
+};
+
+// =======================================================================
+// ==               PART 1: CONSTEXPR LEXER                             ==
+// =======================================================================
+// Same token rules as tokenize() in Parser.cpp, restricted to expressions.
+
+enum class Ct_token_type {
+    OPEN_PAREN, CLOSE_PAREN, PLUS, MINUS, STAR, SLASH,
+    EQUAL_EQUAL, BANG_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL,
+    IDENTIFIER, NUMBER,
+    END_OF_FILE, UNKNOWN
+};
+
+struct Ct_token {
+    Ct_token_type type = Ct_token_type::UNKNOWN;
+    std::size_t start = 0;
+    std::size_t length = 0;
+};
+
+// A fixed-capacity token stream; a source of N chars never has more than N tokens.
+template <std::size_t Cap>
+struct Ct_tokens {
+    Ct_token tokens[Cap + 1]{};
+    std::size_t count = 0;
+};
+
+constexpr bool ct_is_digit(char c) { return c >= '0' && c <= '9'; }
+constexpr bool ct_is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+
+template <std::size_t Cap>
+constexpr Ct_tokens<Cap> ct_tokenize(std::string_view source) {
+    Ct_tokens<Cap> out;
+    std::size_t current = 0;
+    auto push = [&](Ct_token_type type, std::size_t start) {
+        out.tokens[out.count++] = {type, start, current - start};
+    };
+    auto match = [&](char expected) {
+        if (current >= source.length() || source[current] != expected) return false;
+        current++; return true;
+    };
+
+    while (current < source.length()) {
+        std::size_t start = current;
+        char c = source[current++];
+        switch (c) {
+            case ' ': case '\r': case '\t': case '\n': break;
+            case '(': push(Ct_token_type::OPEN_PAREN, start); break;
+            case ')': push(Ct_token_type::CLOSE_PAREN, start); break;
+            case '+': push(Ct_token_type::PLUS, start); break;
+            case '-': push(Ct_token_type::MINUS, start); break;
+            case '*': push(Ct_token_type::STAR, start); break;
+            case '/': push(Ct_token_type::SLASH, start); break;
+            case '=': push(match('=') ? Ct_token_type::EQUAL_EQUAL : Ct_token_type::UNKNOWN, start); break;
+            case '!': push(match('=') ? Ct_token_type::BANG_EQUAL : Ct_token_type::UNKNOWN, start); break;
+            case '<': push(match('=') ? Ct_token_type::LESS_EQUAL : Ct_token_type::LESS, start); break;
+            case '>': push(match('=') ? Ct_token_type::GREATER_EQUAL : Ct_token_type::GREATER, start); break;
+            default:
+                if (ct_is_digit(c)) {
+                    while (current < source.length() && ct_is_digit(source[current])) current++;
+                    push(Ct_token_type::NUMBER, start);
+                } else if (ct_is_alpha(c)) {
+                    while (current < source.length() && (ct_is_alpha(source[current]) || ct_is_digit(source[current]))) current++;
+                    push(Ct_token_type::IDENTIFIER, start);
+                } else {
+                    push(Ct_token_type::UNKNOWN, start);
+                }
+                break;
+        }
+    }
+    out.tokens[out.count++] = {Ct_token_type::END_OF_FILE, current, 0};
+    return out;
+}
+
+// =======================================================================
+// ==               PART 2: CONSTEXPR PARSER                            ==
+// =======================================================================
+// Builds a flat node pool instead of unique_ptr trees, because the result has
+// to survive as a constant. Children are referenced by index.
+
+enum class Ct_node_kind { NUMBER, VARIABLE, BINARY };
+
+struct Ct_node {
+    Ct_node_kind kind = Ct_node_kind::NUMBER;
+    Ct_token_type op = Ct_token_type::UNKNOWN; // For BINARY
+    double value = 0.0;                        // For NUMBER
+    int slot = -1;                             // For VARIABLE
+    int left = -1;
+    int right = -1;
+};
+
+template <std::size_t Cap>
+struct Ct_program {
+    Ct_node nodes[Cap + 1]{};
+    int count = 0;
+    int root = -1;
+
+    // Variables get argument slots in order of first appearance.
+    std::string_view slot_names[Cap + 1]{};
+    int slot_count = 0;
+};
+
+template <std::size_t Cap>
+class Ct_parser {
+public:
+    constexpr Ct_parser(std::string_view source)
+        : m_source(source), m_tokens(ct_tokenize<Cap>(source)) {}
+
+    constexpr Ct_program<Cap> parse() {
+        m_program.root = equality();
+        if (peek().type != Ct_token_type::END_OF_FILE) {
+            throw std::runtime_error("Error: Unexpected token after expression.");
+        }
+        return m_program;
+    }
+
+private:
+    std::string_view m_source;
+    Ct_tokens<Cap> m_tokens;
+    Ct_program<Cap> m_program;
+    std::size_t m_current = 0;
+
+    static constexpr double MAX_EXACT = 9007199254740992.0; // 2^53
+
+    // --- Helper functions to manage the token stream ---
+    constexpr const Ct_token& peek() const { return m_tokens.tokens[m_current]; }
+    constexpr const Ct_token& previous() const { return m_tokens.tokens[m_current - 1]; }
+    constexpr bool check(Ct_token_type type) const { return peek().type == type; }
+    constexpr bool match(Ct_token_type a, Ct_token_type b) {
+        if (check(a) || check(b)) { m_current++; return true; }
+        return false;
+    }
+    constexpr std::string_view text(const Ct_token& token) const {
+        return m_source.substr(token.start, token.length);
+    }
+
+    constexpr int add(Ct_node node) {
+        m_program.nodes[m_program.count] = node;
+        return m_program.count++;
+    }
+    constexpr int binary(Ct_token_type op, int left, int right) {
+        Ct_node node;
+        node.kind = Ct_node_kind::BINARY;
+        node.op = op;
+        node.left = left;
+        node.right = right;
+        return add(node);
+    }
+
+    // Precedence Level 2: Equality (==, !=)
+    constexpr int equality() {
+        int expr = comparison();
+        while (match(Ct_token_type::BANG_EQUAL, Ct_token_type::EQUAL_EQUAL)) {
+            Ct_token_type op = previous().type;
+            expr = binary(op, expr, comparison());
+        }
+        return expr;
+    }
+
+    // Precedence Level 3: Comparison (<, >, <=, >=)
+    constexpr int comparison() {
+        int expr = term();
+        while (match(Ct_token_type::GREATER, Ct_token_type::GREATER_EQUAL) ||
+               match(Ct_token_type::LESS, Ct_token_type::LESS_EQUAL)) {
+            Ct_token_type op = previous().type;
+            expr = binary(op, expr, term());
+        }
+        return expr;
+    }
+
+    // Precedence Level 4: Term (+, -)
+    constexpr int term() {
+        int expr = factor();
+        while (match(Ct_token_type::MINUS, Ct_token_type::PLUS)) {
+            Ct_token_type op = previous().type;
+            expr = binary(op, expr, factor());
+        }
+        return expr;
+    }
+
+    // Precedence Level 5: Factor (*, /)
+    constexpr int factor() {
+        int expr = primary();
+        while (match(Ct_token_type::SLASH, Ct_token_type::STAR)) {
+            Ct_token_type op = previous().type;
+            expr = binary(op, expr, primary());
+        }
+        return expr;
+    }
+
+    // Precedence Level 6: Primary (numbers, variables, grouping)
+    constexpr int primary() {
+        if (match(Ct_token_type::NUMBER, Ct_token_type::NUMBER)) {
+            Ct_node node;
+            node.kind = Ct_node_kind::NUMBER;
+            for (char c : text(previous())) {
+                node.value = node.value * 10 + (c - '0');
+                if (node.value > MAX_EXACT) throw std::runtime_error("Error: Number literal too large to be exact.");
+            }
+            return add(node);
+        }
+
+        if (match(Ct_token_type::IDENTIFIER, Ct_token_type::IDENTIFIER)) {
+            Ct_node node;
+            node.kind = Ct_node_kind::VARIABLE;
+            node.slot = slot_for(text(previous()));
+            return add(node);
+        }
+
+        if (match(Ct_token_type::OPEN_PAREN, Ct_token_type::OPEN_PAREN)) {
+            int expr = equality();
+            if (!match(Ct_token_type::CLOSE_PAREN, Ct_token_type::CLOSE_PAREN)) {
+                throw std::runtime_error("Error: Expect ')' after expression.");
+            }
+            return expr;
+        }
+
+        throw std::runtime_error("Error: Expect expression.");
+    }
+
+    constexpr int slot_for(std::string_view name) {
+        for (int i = 0; i < m_program.slot_count; i++) {
+            if (m_program.slot_names[i] == name) return i;
+        }
+        m_program.slot_names[m_program.slot_count] = name;
+        return m_program.slot_count++;
+    }
+};
+
+// =======================================================================
+// ==               PART 3: EXPRESSION TEMPLATES                        ==
+// =======================================================================
+// Each node kind is a type; the whole tree is one type whose eval() the
+// optimizer flattens completely.
+
+template <double Value>
+struct Ct_constant {
+    static constexpr double eval(const double*) { return Value; }
+};
+
+template <int Slot>
+struct Ct_variable {
+    static constexpr double eval(const double* slots) { return slots[Slot]; }
+};
+
+template <Ct_token_type Op, typename Left, typename Right>
+struct Ct_binary {
+    static constexpr double eval(const double* slots) {
+        double left = Left::eval(slots);
+        double right = Right::eval(slots);
+        if constexpr (Op == Ct_token_type::PLUS)          return left + right;
+        if constexpr (Op == Ct_token_type::MINUS)         return left - right;
+        if constexpr (Op == Ct_token_type::STAR)          return left * right;
+        if constexpr (Op == Ct_token_type::SLASH)         return left / right;
+        if constexpr (Op == Ct_token_type::GREATER)       return left > right;
+        if constexpr (Op == Ct_token_type::GREATER_EQUAL) return left >= right;
+        if constexpr (Op == Ct_token_type::LESS)          return left < right;
+        if constexpr (Op == Ct_token_type::LESS_EQUAL)    return left <= right;
+        if constexpr (Op == Ct_token_type::EQUAL_EQUAL)   return left == right;
+        if constexpr (Op == Ct_token_type::BANG_EQUAL)    return left != right;
+    }
+};
+
+// Walks the constant node pool and names the matching expression-template type.
+template <const auto& Program, int Index>
+constexpr auto ct_build() {
+    constexpr Ct_node node = Program.nodes[Index];
+    if constexpr (node.kind == Ct_node_kind::NUMBER) {
+        return Ct_constant<node.value>{};
+    } else if constexpr (node.kind == Ct_node_kind::VARIABLE) {
+        return Ct_variable<node.slot>{};
+    } else {
+        using Left = decltype(ct_build<Program, node.left>());
+        using Right = decltype(ct_build<Program, node.right>());
+        return Ct_binary<node.op, Left, Right>{};
+    }
+}
+
+template <Fixed_string Source>
+struct Ct_compiled {
+    static constexpr std::size_t capacity = sizeof(Source.data);
+    static constexpr Ct_program<capacity> program = Ct_parser<capacity>(Source.view()).parse();
+    using tree = decltype(ct_build<program, program.root>());
+};
+
+// The callable handed back to user code. Arguments bind to variables in the
+// order they first appear in the source.
+template <typename Tree, int SlotCount, const std::string_view* Names>
+struct Static_expr {
+    static constexpr int arity = SlotCount;
+
+    template <typename... Args>
+    constexpr double operator()(Args... args) const {
+        static_assert(sizeof...(Args) == SlotCount, "Wrong number of arguments for SimPL expression.");
+        const double slots[SlotCount + 1] = {static_cast<double>(args)...};
+        return Tree::eval(slots);
+    }
+
+    // Name of the variable bound to argument `i`, for diagnostics.
+    static constexpr std::string_view slot_name(int i) { return Names[i]; }
+};
+
+template <Fixed_string Source>
+constexpr auto compile() {
+    using compiled = Ct_compiled<Source>;
+    return Static_expr<typename compiled::tree, compiled::program.slot_count, compiled::program.slot_names>{};
+}
+
+// Checked wherever this header is compiled (Parser.cpp includes it in C++20
+// builds), so the compile-time front end cannot drift from the interpreter's.
+static_assert(compile<"a * 2 + (a / b)">()(10, 5) == 22);
+static_assert(compile<"1 + 2 * 3 - 4 / 2">()() == 5);
+static_assert(compile<"x - y - z">()(10, 3, 2) == 5);
+static_assert(compile<"(a + b) * (a - b) == a * a - b * b">()(7, 3) == 1);
+static_assert(compile<"a < b != b < a">()(1, 2) == 1);
+static_assert(compile<"9007199254740992 - 1">()() == 9007199254740991.0);
+static_assert(compile<"n / 2">().slot_name(0) == "n");
+
+} // namespace simpl
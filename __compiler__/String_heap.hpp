@@ -0,0 +1,346 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// =======================================================================
+// ==          STRING HEAP (Ropes, Interning, Mark-Compact GC)          ==
+// =======================================================================
+// Script strings live here, not in std::string, so that building a large
+// string by repeated '+' costs a node per step instead of a copy per step.
+//
+//   Handles   a string is a 32-bit handle into a node table. Nodes never
+//             move, so handles stay valid across collections.
+//   Ropes     concatenation makes CONCAT nodes pointing at both halves,
+//             kept balanced (see concat()). The bytes are copied only when a
+//             comparison needs them in one piece. That "flattens" the node
+//             in place, turning it into a FLAT node whose children may
+//             become garbage. Printing and indexing walk the pieces instead.
+//   Interning FLAT strings up to SHORT_STRING bytes are deduplicated, so
+//             keys, single characters and the like exist once.
+//   Arena     the bytes of all FLAT nodes share one buffer. The collector
+//             marks from the roots the interpreter passes in and frees dead
+//             nodes. It then slides the surviving bytes down over the gaps
+//             (mark-compact). Collections are only requested here; the
+//             interpreter runs them at a point where every live string is
+//             in its slots (see collection_due()).
+//
+// Every operation takes the heap's lock, because the iterations of a
+// parallel loop share it. Ropes are walked with an explicit stack, so a
+// rope a million concatenations deep needs no recursion.
+
+class String_heap {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle EMPTY = 0;
+    static constexpr size_t SHORT_STRING = 16;
+
+    struct Stats {
+        size_t collections = 0;
+        size_t live_nodes = 0;
+        size_t arena_bytes = 0;      // Bytes in use by FLAT nodes, garbage included
+        size_t reclaimed_nodes = 0;  // Over all collections
+        size_t reclaimed_bytes = 0;
+    };
+
+    String_heap() {
+        m_nodes.push_back({0, 0, 0, 0, Kind::FLAT}); // EMPTY
+    }
+
+    String_heap(const String_heap&) = delete;
+    String_heap& operator=(const String_heap&) = delete;
+
+    Handle from_text(std::string_view text) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return make_flat(text);
+    }
+
+    // The string for a literal in the program: made once per distinct text
+    // and kept alive for the heap's lifetime.
+    Handle literal(std::string_view text) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_literals.find(text);
+        if (it != m_literals.end()) return it->second;
+        Handle h = make_flat(text);
+        m_literals.emplace(std::string(text), h);
+        return h;
+    }
+
+    // Appending to a rope first joins the new piece with the pieces along
+    // the rope's right edge that are not more than twice its size, like the
+    // carries of a binary counter (prepending works the same on the left
+    // edge). The edges then at least double in size per level, so repeated
+    // appends or prepends build a rope of logarithmic depth, not a list.
+    Handle concat(Handle a, Handle b) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_nodes[a].length == 0) return b;
+        if (m_nodes[b].length == 0) return a;
+        if (m_nodes[a].length >= m_nodes[b].length) {
+            while (m_nodes[a].kind == Kind::CONCAT && m_nodes[m_nodes[a].right].length <= 2 * m_nodes[b].length) {
+                b = join(m_nodes[a].right, b);
+                a = m_nodes[a].left;
+            }
+        } else {
+            while (m_nodes[b].kind == Kind::CONCAT && m_nodes[m_nodes[b].left].length <= 2 * m_nodes[a].length) {
+                a = join(a, m_nodes[b].left);
+                b = m_nodes[b].right;
+            }
+        }
+        return join(a, b);
+    }
+
+    uint64_t length(Handle h) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_nodes[h].length;
+    }
+
+    // <0, 0 or >0, comparing bytes like std::string_view::compare.
+    int compare(Handle a, Handle b) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (a == b) return 0;
+        flatten(a);
+        flatten(b);
+        return bytes(a).compare(bytes(b));
+    }
+
+    bool equal(Handle a, Handle b) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_nodes[a].length != m_nodes[b].length) return false; // No need to flatten
+        }
+        return compare(a, b) == 0;
+    }
+
+    // The one-byte string at `index`, which must be below length(h). Found by
+    // walking the rope, which concat() keeps shallow.
+    Handle byte_at(Handle h, uint64_t index) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Handle node = h;
+        while (m_nodes[node].kind == Kind::CONCAT) {
+            const Node& n = m_nodes[node];
+            uint64_t left_length = m_nodes[n.left].length;
+            if (index < left_length) {
+                node = n.left;
+            } else {
+                index -= left_length;
+                node = n.right;
+            }
+        }
+        char c = m_arena[m_nodes[node].offset + index];
+        return make_flat(std::string_view(&c, 1));
+    }
+
+    void write(std::ostream& out, Handle h) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for_each_piece(h, [&](std::string_view piece) { out.write(piece.data(), static_cast<std::streamsize>(piece.size())); });
+    }
+
+    std::string to_string(Handle h) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string text;
+        text.reserve(m_nodes[h].length);
+        for_each_piece(h, [&](std::string_view piece) { text += piece; });
+        return text;
+    }
+
+    // Set once enough has been allocated since the last collection to be
+    // worth one; read without the lock on every statement.
+    bool collection_due() const { return m_due.load(std::memory_order_relaxed); }
+
+    // Frees every node not reachable from `roots` (or a literal) and
+    // compacts the arena. No other heap operation may run at the same time.
+    void collect(const std::vector<Handle>& roots) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        mark(roots);
+        sweep();
+        compact();
+        m_stats.collections++;
+        m_next_collection_bytes = std::max(MIN_COLLECTION_BYTES, m_arena.size() * 2);
+        m_next_collection_nodes = std::max(MIN_COLLECTION_NODES, live_nodes() * 2);
+        m_due.store(false, std::memory_order_relaxed);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Stats s = m_stats;
+        s.live_nodes = live_nodes();
+        s.arena_bytes = m_arena.size();
+        return s;
+    }
+
+private:
+    enum class Kind : uint8_t { FLAT, CONCAT, FREE };
+
+    struct Node {
+        uint64_t offset;  // FLAT: where the bytes start in the arena
+        uint64_t length;
+        Handle left;      // CONCAT: the two halves
+        Handle right;
+        Kind kind;
+        bool marked = false;
+    };
+
+    static constexpr size_t MIN_COLLECTION_BYTES = 8u << 20;
+    static constexpr size_t MIN_COLLECTION_NODES = 1u << 20;
+
+    mutable std::mutex m_mutex;
+    std::vector<Node> m_nodes;
+    std::vector<Handle> m_free;
+    std::vector<char> m_arena;
+    std::unordered_map<std::string, Handle> m_interned;
+    std::map<std::string, Handle, std::less<>> m_literals;
+    std::atomic<bool> m_due{false};
+    size_t m_next_collection_bytes = MIN_COLLECTION_BYTES;
+    size_t m_next_collection_nodes = MIN_COLLECTION_NODES;
+    Stats m_stats;
+
+    size_t live_nodes() const { return m_nodes.size() - m_free.size(); }
+
+    std::string_view bytes(Handle h) const {
+        return std::string_view(m_arena.data() + m_nodes[h].offset, m_nodes[h].length);
+    }
+
+    Handle add_node(Node node) {
+        Handle h;
+        if (!m_free.empty()) {
+            h = m_free.back();
+            m_free.pop_back();
+            m_nodes[h] = node;
+        } else {
+            if (m_nodes.size() > UINT32_MAX) throw std::runtime_error("Too many strings.");
+            h = static_cast<Handle>(m_nodes.size());
+            m_nodes.push_back(node);
+        }
+        if (live_nodes() > m_next_collection_nodes) m_due.store(true, std::memory_order_relaxed);
+        return h;
+    }
+
+    // Appends `length` bytes to the arena and returns their offset.
+    uint64_t reserve_bytes(uint64_t length) {
+        uint64_t offset = m_arena.size();
+        m_arena.resize(offset + length);
+        if (m_arena.size() > m_next_collection_bytes) m_due.store(true, std::memory_order_relaxed);
+        return offset;
+    }
+
+    Handle make_flat(std::string_view text) {
+        if (text.empty()) return EMPTY;
+        if (text.size() <= SHORT_STRING) {
+            auto it = m_interned.find(std::string(text));
+            if (it != m_interned.end()) return it->second;
+        }
+        uint64_t offset = reserve_bytes(text.size());
+        std::memcpy(m_arena.data() + offset, text.data(), text.size());
+        Handle h = add_node({offset, text.size(), 0, 0, Kind::FLAT});
+        if (text.size() <= SHORT_STRING) m_interned.emplace(std::string(text), h);
+        return h;
+    }
+
+    // A new string holding `a` then `b`: flat (and interned) if short.
+    Handle join(Handle a, Handle b) {
+        uint64_t length = m_nodes[a].length + m_nodes[b].length;
+        if (length <= SHORT_STRING) {
+            char buffer[SHORT_STRING];
+            copy_out(a, buffer);
+            copy_out(b, buffer + m_nodes[a].length);
+            return make_flat(std::string_view(buffer, length));
+        }
+        return add_node({0, length, a, b, Kind::CONCAT});
+    }
+
+    // Calls fn(bytes) for each FLAT piece of `h`, left to right.
+    template <typename Fn>
+    void for_each_piece(Handle h, Fn&& fn) const {
+        std::vector<Handle> stack{h};
+        while (!stack.empty()) {
+            const Node& node = m_nodes[stack.back()];
+            Handle current = stack.back();
+            stack.pop_back();
+            if (node.kind == Kind::CONCAT) {
+                stack.push_back(node.right);
+                stack.push_back(node.left);
+            } else if (node.length) {
+                fn(bytes(current));
+            }
+        }
+    }
+
+    void copy_out(Handle h, char* out) const {
+        for_each_piece(h, [&](std::string_view piece) {
+            std::memcpy(out, piece.data(), piece.size());
+            out += piece.size();
+        });
+    }
+
+    // Makes `h` FLAT by copying its pieces into one new run of the arena.
+    void flatten(Handle h) {
+        if (m_nodes[h].kind == Kind::FLAT) return;
+        uint64_t length = m_nodes[h].length;
+        uint64_t offset = reserve_bytes(length); // Before taking pointers: this may move the arena
+        copy_out(h, m_arena.data() + offset);
+        m_nodes[h] = {offset, length, 0, 0, Kind::FLAT};
+    }
+
+    void mark(const std::vector<Handle>& roots) {
+        std::vector<Handle> stack(roots);
+        stack.push_back(EMPTY);
+        for (const auto& [key, h] : m_literals) stack.push_back(h);
+        while (!stack.empty()) {
+            Node& node = m_nodes[stack.back()];
+            stack.pop_back();
+            if (node.marked) continue;
+            node.marked = true;
+            if (node.kind == Kind::CONCAT) {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+    }
+
+    void sweep() {
+        for (auto it = m_interned.begin(); it != m_interned.end();) {
+            if (!m_nodes[it->second].marked) it = m_interned.erase(it);
+            else ++it;
+        }
+        for (size_t h = 0; h < m_nodes.size(); h++) {
+            Node& node = m_nodes[h];
+            if (node.kind == Kind::FREE) continue;
+            if (!node.marked) {
+                node.kind = Kind::FREE;
+                m_free.push_back(static_cast<Handle>(h));
+                m_stats.reclaimed_nodes++;
+            }
+        }
+    }
+
+    // Slides the bytes of live FLAT nodes down, in arena order, over the gaps.
+    void compact() {
+        std::vector<Handle> flats;
+        for (size_t h = 0; h < m_nodes.size(); h++) {
+            Node& node = m_nodes[h];
+            if (node.marked && node.kind == Kind::FLAT && node.length) flats.push_back(static_cast<Handle>(h));
+            node.marked = false;
+        }
+        std::sort(flats.begin(), flats.end(), [&](Handle a, Handle b) { return m_nodes[a].offset < m_nodes[b].offset; });
+        uint64_t top = 0;
+        for (Handle h : flats) {
+            Node& node = m_nodes[h];
+            if (node.offset != top) std::memmove(m_arena.data() + top, m_arena.data() + node.offset, node.length);
+            node.offset = top;
+            top += node.length;
+        }
+        m_stats.reclaimed_bytes += m_arena.size() - top;
+        m_arena.resize(top);
+        m_arena.shrink_to_fit();
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "Simd_scan.hpp"
+
+// =======================================================================
+// ==                 STRING LITERALS (Scan and Decode)                 ==
+// =======================================================================
+// Shared by both lexers. The body of a literal is skipped with a SIMD search
+// for the next '"' or '\', so long runs of plain text cost one vector compare
+// per 32 bytes. A literal without escapes is returned as a view of the source
+// itself; one with escapes is decoded once, span by span, into a buffer the
+// caller supplies and reuses. Literals may span lines.
+//
+// Escapes: \n \t \r \0 \\ \" \'
+
+struct String_scan {
+    size_t end = 0;               // One past the closing quote
+    std::string_view value;       // Decoded contents, no delimiters
+    const char* error = nullptr;  // Set if the literal is malformed; `end` is then where lexing resumes
+};
+
+// `open` is the offset of the opening quote. `value` points into `source` or
+// into `scratch`, and is only valid until either changes.
+inline String_scan scan_string_literal(std::string_view source, size_t open, std::string& scratch) {
+    String_scan scan;
+    size_t begin = open + 1;
+    size_t pos = simd_find_either(source, begin, '"', '\\');
+    if (pos < source.size() && source[pos] == '"') { // No escapes: no copy
+        scan.end = pos + 1;
+        scan.value = source.substr(begin, pos - begin);
+        return scan;
+    }
+
+    scratch.clear();
+    while (pos < source.size() && source[pos] == '\\') {
+        scratch.append(source.data() + begin, pos - begin);
+        if (pos + 1 >= source.size()) break;
+        switch (source[pos + 1]) {
+            case 'n': scratch += '\n'; break;
+            case 't': scratch += '\t'; break;
+            case 'r': scratch += '\r'; break;
+            case '0': scratch += '\0'; break;
+            case '\\': scratch += '\\'; break;
+            case '"': scratch += '"'; break;
+            case '\'': scratch += '\''; break;
+            default:
+                if (!scan.error) scan.error = "Unknown escape sequence in string.";
+                scratch += source[pos + 1];
+                break;
+        }
+        begin = pos + 2;
+        pos = simd_find_either(source, begin, '"', '\\');
+    }
+    if (pos >= source.size()) {
+        scan.end = source.size();
+        scan.error = "Unterminated string.";
+        return scan;
+    }
+    scratch.append(source.data() + begin, pos - begin);
+    scan.end = pos + 1;
+    scan.value = scratch;
+    return scan;
+}
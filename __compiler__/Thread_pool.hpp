@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// =======================================================================
+// ==                 THREAD POOL (Chunked Scheduling)                  ==
+// =======================================================================
+// A fixed set of worker threads that run one "job" at a time. A job is split
+// into numbered chunks; workers (and the calling thread) claim the next chunk
+// from an atomic counter until none are left, so uneven chunks balance out
+// on their own. Which thread ran a chunk never matters to the caller: results
+// are written per chunk index and combined afterwards in index order.
+
+class Thread_pool {
+public:
+    explicit Thread_pool(unsigned threads = std::max(1u, std::thread::hardware_concurrency())) {
+        // The calling thread also works, so start one fewer.
+        for (unsigned i = 1; i < threads; i++) {
+            m_workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~Thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (auto& worker : m_workers) worker.join();
+    }
+
+    Thread_pool(const Thread_pool&) = delete;
+    Thread_pool& operator=(const Thread_pool&) = delete;
+
+    // Process-wide pool sized to the machine.
+    static Thread_pool& shared() {
+        static Thread_pool pool;
+        return pool;
+    }
+
+    unsigned size() const { return static_cast<unsigned>(m_workers.size()) + 1; }
+
+    // Calls body(chunk) for every chunk in [0, chunk_count) and waits for all of
+    // them. Called from inside a pool worker, it runs inline instead of nesting.
+    // The first exception thrown by a chunk (lowest index) is rethrown here.
+    void run_chunks(size_t chunk_count, const std::function<void(size_t)>& body) {
+        std::vector<std::exception_ptr> errors(chunk_count);
+        if (t_inside_pool || m_workers.empty() || chunk_count <= 1) {
+            for (size_t i = 0; i < chunk_count; i++) run_one(body, i, errors);
+        } else {
+            std::unique_lock<std::mutex> job_lock(m_job_mutex); // One job at a time
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_body = &body;
+                m_errors = &errors;
+                m_chunk_count = chunk_count;
+                m_next_chunk.store(0);
+                m_active = static_cast<unsigned>(m_workers.size());
+                m_generation++;
+            }
+            m_wake.notify_all();
+
+            t_inside_pool = true;
+            claim_chunks(body, chunk_count, errors);
+            t_inside_pool = false;
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return m_active == 0; });
+            m_body = nullptr;
+        }
+        for (auto& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+    }
+
+private:
+    std::vector<std::thread> m_workers;
+    std::mutex m_job_mutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    bool m_stopping = false;
+    unsigned long m_generation = 0;
+    unsigned m_active = 0;
+
+    const std::function<void(size_t)>* m_body = nullptr;
+    std::vector<std::exception_ptr>* m_errors = nullptr;
+    size_t m_chunk_count = 0;
+    std::atomic<size_t> m_next_chunk{0};
+
+    inline static thread_local bool t_inside_pool = false;
+
+    static void run_one(const std::function<void(size_t)>& body, size_t chunk, std::vector<std::exception_ptr>& errors) {
+        try {
+            body(chunk);
+        } catch (...) {
+            errors[chunk] = std::current_exception();
+        }
+    }
+
+    void claim_chunks(const std::function<void(size_t)>& body, size_t chunk_count, std::vector<std::exception_ptr>& errors) {
+        for (size_t chunk = m_next_chunk++; chunk < chunk_count; chunk = m_next_chunk++) {
+            run_one(body, chunk, errors);
+        }
+    }
+
+    void worker_loop() {
+        t_inside_pool = true;
+        unsigned long seen = 0;
+        while (true) {
+            const std::function<void(size_t)>* body;
+            std::vector<std::exception_ptr>* errors;
+            size_t chunk_count;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&] { return m_stopping || m_generation != seen; });
+                if (m_stopping) return;
+                seen = m_generation;
+                body = m_body;
+                errors = m_errors;
+                chunk_count = m_chunk_count;
+            }
+            claim_chunks(*body, chunk_count, *errors);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_active == 0) m_done.notify_one();
+            }
+        }
+    }
+};
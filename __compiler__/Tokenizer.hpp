@@ -2,9 +2,12 @@
 
 #include <string>
 #include <vector>
-#include <cctype>
 #include <unordered_map>
 #include <string_view>
+#include <cstdint>
+
+#include "String_literal.hpp"
+#include "Utf8.hpp"
 
 // It's best practice to avoid 'using namespace std;' in header files.
 // We will use std:: qualification instead.
@@ -19,6 +22,8 @@ enum class TokenType {
     KEYWORD_LET,       // New: for variable declaration
     KEYWORD_WHILE,     // New: while loops
     KEYWORD_FOR,       // New: for loops
+    KEYWORD_PARALLEL,  // New: parallel for loops
+    KEYWORD_REDUCE,    // New: reduction clause of a parallel for
     
     // --- Data Types & Booleans ---
     KEYWORD_INT,       // New: int type
@@ -67,18 +72,19 @@ enum class TokenType {
     END_OF_FILE
 };
 
-// Token struct now includes the line number for better error reporting.
+// Tokens record where they start as a byte offset into the source. Line and
+// column are worked out only when needed, with Source_lines.
 struct Token {
     std::string literal;
     TokenType type;
-    int line; // New: To track which line the token is on.
+    uint32_t offset; // Byte offset of the token's first character
 };
 
 class Tokenizer {
 public:
     // Constructor takes a string_view for efficiency.
     Tokenizer(std::string_view source)
-        : m_source(source), m_line(1) { // Start at line 1
+        : m_source(source), m_first_invalid(utf8_first_invalid(source)) {
         // Initialize the keywords map once using a static block.
         if (keywords.empty()) {
             // Commands and control flow
@@ -89,6 +95,8 @@ public:
             keywords["let"] = TokenType::KEYWORD_LET;
             keywords["while"] = TokenType::KEYWORD_WHILE;
             keywords["for"] = TokenType::KEYWORD_FOR;
+            keywords["parallel"] = TokenType::KEYWORD_PARALLEL;
+            keywords["reduce"] = TokenType::KEYWORD_REDUCE;
             
             // Data types
             keywords["int"] = TokenType::KEYWORD_INT;
@@ -159,30 +167,29 @@ public:
                 case '"': tokens.push_back(string_literal()); break;
                 case '\'': tokens.push_back(char_literal()); break;
                 
-                // Ignore whitespace
+                // Ignore whitespace (newlines included; see Source_lines)
                 case ' ':
                 case '\r':
                 case '\t':
-                    break;
-                
-                // Handle newlines
                 case '\n':
-                    m_line++;
                     break;
 
                 default:
-                    if (std::isdigit(c)) {
+                    if (is_ascii_digit(c)) {
                         tokens.push_back(number_literal());
-                    } else if (std::isalpha(c) || c == '_') {
+                    } else if (size_t length = identifier_char_length(m_source, m_start, true)) {
+                        m_current = m_start + length;
                         tokens.push_back(identifier());
                     } else {
+                        size_t bytes = utf8_length(m_start); // The whole character, or one malformed byte
+                        m_current = m_start + (bytes ? bytes : 1);
                         tokens.push_back(make_token(TokenType::UNKNOWN));
                     }
                     break;
             }
         }
 
-        tokens.push_back({"", TokenType::END_OF_FILE, m_line});
+        tokens.push_back({"", TokenType::END_OF_FILE, static_cast<uint32_t>(m_source.length())});
         return tokens;
     }
 
@@ -190,7 +197,8 @@ private:
     std::string_view m_source;
     size_t m_start = 0;
     size_t m_current = 0;
-    int m_line; // New: Tracks the current line number
+    size_t m_first_invalid; // Offset of the first malformed UTF-8 byte, or the source length
+    std::string m_scratch; // Decoded strings with escapes, reused
 
     inline static std::unordered_map<std::string, TokenType> keywords;
 
@@ -220,18 +228,27 @@ private:
         return true;
     }
 
+    // Bytes in the character at `pos`: 1 for ASCII, 0 for a malformed byte.
+    // Multi-byte characters before the first malformed byte need no checks.
+    size_t utf8_length(size_t pos) const {
+        unsigned char lead = static_cast<unsigned char>(m_source[pos]);
+        if (lead < 0x80) return 1;
+        if (pos < m_first_invalid) return lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+        return utf8_sequence_length(m_source, pos);
+    }
+
     Token make_token(TokenType type) const {
-        return {std::string(m_source.substr(m_start, m_current - m_start)), type, m_line};
+        return {std::string(m_source.substr(m_start, m_current - m_start)), type, static_cast<uint32_t>(m_start)};
     }
     
+    // The literal holds the decoded contents, without the quotes.
+    // Unterminated strings and unknown escapes give an UNKNOWN token.
     Token string_literal() {
-        while (peek() != '"' && !is_at_end()) {
-            if (peek() == '\n') m_line++; // Support multi-line strings
-            advance();
-        }
-        if (is_at_end()) return make_token(TokenType::UNKNOWN); // Unterminated string
-        advance(); // Consume the closing quote
-        return make_token(TokenType::STRING_LITERAL);
+        String_scan scan = scan_string_literal(m_source, m_start, m_scratch);
+        m_current = scan.end;
+        bool malformed = m_first_invalid >= m_start && m_first_invalid < scan.end;
+        if (scan.error || malformed) return make_token(TokenType::UNKNOWN);
+        return {std::string(scan.value), TokenType::STRING_LITERAL, static_cast<uint32_t>(m_start)};
     }
     
     Token char_literal() {
@@ -246,15 +263,15 @@ private:
 
     // Now supports floating point numbers
     Token number_literal() {
-        while (std::isdigit(peek())) {
+        while (is_ascii_digit(peek())) {
             advance();
         }
         
         // Look for a fractional part.
-        if (peek() == '.' && std::isdigit(peek_next())) {
+        if (peek() == '.' && is_ascii_digit(peek_next())) {
             // Consume the "."
             advance();
-            while (std::isdigit(peek())) {
+            while (is_ascii_digit(peek())) {
                 advance();
             }
             return make_token(TokenType::FLOAT_LITERAL);
@@ -264,8 +281,10 @@ private:
     }
 
     Token identifier() {
-        while (std::isalnum(peek()) || peek() == '_') {
-            advance();
+        while (!is_at_end()) {
+            size_t length = identifier_char_length(m_source, m_current, false);
+            if (length == 0) break;
+            m_current += length;
         }
         
         auto text = m_source.substr(m_start, m_current - m_start);
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+#include "Simd_scan.hpp"
+
+// =======================================================================
+// ==                 UTF-8 (Validation and Identifiers)                ==
+// =======================================================================
+// Sources are UTF-8. Validation skips ASCII 32 bytes at a time with a SIMD
+// scan and only decodes the multi-byte sequences it stops at, so ASCII-only
+// scripts pay one vector test per 32 bytes. Identifiers may use non-ASCII
+// letters (see is_identifier_code_point); operators, digits and whitespace
+// stay ASCII. The helpers take unsigned char so bytes >= 0x80 never reach
+// <cctype>.
+
+// Length of the well-formed multi-byte sequence starting at text[i], or 0 if
+// it is malformed (bad continuation, overlong form, surrogate, > U+10FFFF).
+inline size_t utf8_sequence_length(std::string_view text, size_t i) {
+    auto byte = [&](size_t k) { return i + k < text.size() ? static_cast<unsigned char>(text[i + k]) : 0u; };
+    auto continuation = [](unsigned b) { return (b & 0xC0) == 0x80; };
+    unsigned lead = byte(0);
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        return continuation(byte(1)) ? 2 : 0;
+    }
+    if (lead >= 0xE0 && lead <= 0xEF) {
+        unsigned b1 = byte(1);
+        if (lead == 0xE0 && b1 < 0xA0) return 0; // Overlong
+        if (lead == 0xED && b1 > 0x9F) return 0; // Surrogate
+        return continuation(b1) && continuation(byte(2)) ? 3 : 0;
+    }
+    if (lead >= 0xF0 && lead <= 0xF4) {
+        unsigned b1 = byte(1);
+        if (lead == 0xF0 && b1 < 0x90) return 0; // Overlong
+        if (lead == 0xF4 && b1 > 0x8F) return 0; // Above U+10FFFF
+        return continuation(b1) && continuation(byte(2)) && continuation(byte(3)) ? 4 : 0;
+    }
+    return 0;
+}
+
+// Offset of the first malformed byte, or text.size() if `text` is valid UTF-8.
+inline size_t utf8_first_invalid(std::string_view text) {
+    size_t i = simd_skip_ascii(text, 0);
+    while (i < text.size()) {
+        size_t length = utf8_sequence_length(text, i);
+        if (length == 0) return i;
+        i = simd_skip_ascii(text, i + length);
+    }
+    return text.size();
+}
+
+inline bool is_ascii_digit(unsigned char c) { return c >= '0' && c <= '9'; }
+
+// ASCII only: non-ASCII characters are classified by code point below.
+inline bool is_identifier_start(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+inline bool is_identifier_part(unsigned char c) { return is_identifier_start(c) || is_ascii_digit(c); }
+
+// The code point of the well-formed `length`-byte sequence at text[i].
+inline char32_t utf8_decode(std::string_view text, size_t i, size_t length) {
+    auto byte = [&](size_t k) { return static_cast<char32_t>(static_cast<unsigned char>(text[i + k])); };
+    if (length == 1) return byte(0);
+    char32_t cp = byte(0) & (0xFF >> (length + 1));
+    for (size_t k = 1; k < length; k++) cp = cp << 6 | (byte(k) & 0x3F);
+    return cp;
+}
+
+// Whether a non-ASCII code point may be part of an identifier (or, with
+// `start`, begin one). This approximates Unicode's XID_Start/XID_Continue
+// by ruling out the ranges that hold whitespace, punctuation, symbols,
+// controls and private use, so a no-break space, U+2212 MINUS SIGN or a
+// curly quote is never silently taken into a name; letters of every script
+// pass. Combining marks may continue an identifier but not begin one.
+inline bool is_identifier_code_point(char32_t cp, bool start) {
+    struct Range { char32_t first, last; };
+    static constexpr Range excluded[] = {
+        {0x0080, 0x00A9}, {0x00AB, 0x00B4}, {0x00B6, 0x00B9}, {0x00BB, 0x00BF}, // C1 controls, Latin-1 punctuation and signs
+        {0x00D7, 0x00D7}, {0x00F7, 0x00F7},                                     // Multiplication and division signs
+        {0x037E, 0x037E}, {0x0387, 0x0387},                                     // Greek question mark, ano teleia
+        {0x055A, 0x055F}, {0x0589, 0x058A}, {0x05BE, 0x05BE}, {0x05C0, 0x05C0}, // Armenian and Hebrew punctuation
+        {0x05C3, 0x05C3}, {0x05C6, 0x05C6}, {0x05F3, 0x05F4},
+        {0x0600, 0x060F}, {0x061B, 0x061F}, {0x066A, 0x066D}, {0x06D4, 0x06D4}, // Arabic punctuation
+        {0x0964, 0x0965}, {0x0970, 0x0970}, {0x0E3F, 0x0E3F}, {0x0E4F, 0x0E4F}, // Indic and Thai punctuation
+        {0x0E5A, 0x0E5B}, {0x10FB, 0x10FB}, {0x1360, 0x1368}, {0x166D, 0x166E},
+        {0x1680, 0x1680}, {0x169B, 0x169C}, {0x16EB, 0x16ED}, {0x180E, 0x180E}, // Ogham space, runic punctuation
+        {0x2000, 0x206F},                                                       // General punctuation, spaces, invisible operators
+        {0x20A0, 0x20CF},                                                       // Currency signs
+        {0x2190, 0x245F}, {0x2500, 0x2BFF},                                     // Arrows, mathematical operators, technical, box drawing, shapes, dingbats
+        {0x2E00, 0x2E7F},                                                       // Supplemental punctuation
+        {0x3000, 0x3004}, {0x3008, 0x3020}, {0x3030, 0x3030}, {0x303D, 0x303F}, // CJK spaces, brackets and marks
+        {0x30FB, 0x30FB},                                                       // Katakana middle dot
+        {0xD800, 0xF8FF},                                                       // Surrogates, private use
+        {0xFD3E, 0xFD3F}, {0xFE10, 0xFE1F}, {0xFE30, 0xFE6F},                   // Ornate parentheses, vertical and small forms
+        {0xFEFF, 0xFEFF},                                                       // Byte order mark
+        {0xFF01, 0xFF0F}, {0xFF1A, 0xFF20}, {0xFF3B, 0xFF3E}, {0xFF40, 0xFF40}, // Fullwidth punctuation
+        {0xFF5B, 0xFF65}, {0xFFE0, 0xFFFF},                                     // Fullwidth signs, specials
+        {0x1F000, 0x1FAFF},                                                     // Game pieces, emoji and pictographs
+        {0xE0000, 0x10FFFF},                                                    // Tags, variation selectors, private use planes
+    };
+    static constexpr Range marks[] = {
+        {0x0300, 0x036F}, {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x20D0, 0x20FF}, {0xFE20, 0xFE2F},
+    };
+    auto in = [cp](const auto& ranges) {
+        for (const Range& r : ranges) {
+            if (cp < r.first) return false; // Sorted
+            if (cp <= r.last) return true;
+        }
+        return false;
+    };
+    return !in(excluded) && !(start && in(marks));
+}
+
+// Bytes in the identifier character at text[i] (one that may begin an
+// identifier, if `start`), or 0 if there is none there or it is malformed.
+inline size_t identifier_char_length(std::string_view text, size_t i, bool start) {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    if (c < 0x80) return (start ? is_identifier_start(c) : is_identifier_part(c)) ? 1 : 0;
+    size_t length = utf8_sequence_length(text, i);
+    return length && is_identifier_code_point(utf8_decode(text, i, length), start) ? length : 0;
+}
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Document.hpp"
+
+// Where the brackets ({}, () and []) are, for jumping to a bracket's match
+// and folding blocks. Each line is summarized by how it changes the bracket
+// depth: its net change, the lowest the depth dips below its starting value
+// (reading left to right) and the highest it rises above its ending value
+// (reading right to left). The summaries are kept in a balanced tree (a
+// treap, ordered by line), where every node also holds the combined summary
+// of its subtree. So
+//
+//   - an edit replaces just the edited lines' summaries, in O(log n), and
+//   - a matching bracket several lines away is found by descending the tree
+//     to the first line where the depth gets back to the bracket's level,
+//     also in O(log n), then scanning that one line.
+//
+// Brackets in string literals and // comments are skipped. Brackets match by
+// depth alone; match_kind() tells whether the pair found is of one kind.
+
+class Bracket_index {
+public:
+    Bracket_index() : m_rng(0x5eed) {}
+
+    // Keeps the index in step with `document`, a batch at a time (see
+    // Document); call before loading it.
+    void attach(Document& document) {
+        document.on_edit([this](const Document& doc, const Line_edits& edits) {
+            // Each run costs O(log n) in the tree, so they are just made in turn.
+            for (const Line_edit& edit : edits) {
+                std::vector<Summary> lines;
+                lines.reserve(edit.new_count);
+                for (size_t i = edit.first; i < edit.first + edit.new_count; i++) lines.push_back(summarize(doc.line(i)));
+                replace(edit.first, edit.old_lines.size(), lines);
+            }
+        }, true);
+    }
+
+    // Calls fn(column, c) for each bracket `c` in `line` that is code.
+    template <typename Fn>
+    static void for_each_bracket(std::string_view line, Fn&& fn) {
+        for (size_t i = 0; i < line.size(); i++) {
+            char c = line[i];
+            if (c == '"' || c == '\'') {
+                for (i++; i < line.size() && line[i] != c; i++) {
+                    if (line[i] == '\\') i++;
+                }
+            } else if (c == '/' && i + 1 < line.size() && line[i + 1] == '/') {
+                return;
+            } else if (is_open(c) || is_close(c)) {
+                fn(i, c);
+            }
+        }
+    }
+
+    static bool is_open(char c) { return c == '{' || c == '(' || c == '['; }
+    static bool is_close(char c) { return c == '}' || c == ')' || c == ']'; }
+    static bool match_kind(char open, char close) {
+        return (open == '{' && close == '}') || (open == '(' && close == ')') || (open == '[' && close == ']');
+    }
+
+    // The bracket matching the one at `at` in `document` (which must be a
+    // bracket that is code), or nothing if it is unbalanced.
+    std::optional<Position> match(const Document& document, Position at) const {
+        char c = document.line(at.line)[at.column];
+        return is_open(c) ? match_forward(document, at) : match_backward(document, at);
+    }
+
+    // The innermost open bracket of kind `open` whose block contains `at`.
+    std::optional<Position> enclosing(const Document& document, Position at, char open) const {
+        for (;;) {
+            // Brackets before `at` on its line, innermost last, that are still
+            // open at `at`, and the closes there that end blocks opened earlier.
+            std::vector<Position> pending;
+            int32_t unmatched = 0;
+            for_each_bracket(document.line(at.line), [&](size_t column, char c) {
+                if (column >= at.column) return;
+                if (is_open(c)) pending.push_back({at.line, column});
+                else if (!pending.empty()) pending.pop_back();
+                else unmatched++;
+            });
+            while (!pending.empty()) {
+                if (document.line(pending.back().line)[pending.back().column] == open) return pending.back();
+                pending.pop_back();
+            }
+            // Otherwise it opened on an earlier line, outside the blocks those
+            // closes ended: step out to the next level and look around it.
+            auto outer = open_before(document, {at.line, 0}, 1 + unmatched);
+            if (!outer) return std::nullopt;
+            if (document.line(outer->line)[outer->column] == open) return outer;
+            at = *outer;
+        }
+    }
+
+    size_t line_count() const { return size(m_root); }
+
+private:
+    struct Summary {
+        int32_t net = 0;         // Opens minus closes
+        int32_t min_prefix = 0;  // Lowest depth reached, relative to the start (<= 0)
+        int32_t max_suffix = 0;  // Highest depth above the end seen reading backwards (>= 0)
+    };
+
+    static Summary combine(const Summary& a, const Summary& b) {
+        return {a.net + b.net, std::min(a.min_prefix, a.net + b.min_prefix), std::max(b.max_suffix, b.net + a.max_suffix)};
+    }
+
+    static Summary summarize(std::string_view line) {
+        Summary s;
+        int32_t depth = 0;
+        std::vector<int32_t> after; // Depth after each bracket
+        for_each_bracket(line, [&](size_t, char c) {
+            depth += is_open(c) ? 1 : -1;
+            s.min_prefix = std::min(s.min_prefix, depth);
+            after.push_back(depth);
+        });
+        s.net = depth;
+        // Read backwards from the end, the suffix starting at each bracket.
+        for (size_t k = 0; k < after.size(); k++) {
+            int32_t before = k ? after[k - 1] : 0;
+            s.max_suffix = std::max(s.max_suffix, depth - before);
+        }
+        return s;
+    }
+
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Node {
+        Summary line;
+        Summary total;    // Of the subtree
+        uint32_t size;    // Lines in the subtree
+        uint32_t priority;
+        uint32_t left = NIL;
+        uint32_t right = NIL;
+    };
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_free;
+    uint32_t m_root = NIL;
+    std::mt19937 m_rng;
+
+    uint32_t size(uint32_t t) const { return t == NIL ? 0 : m_nodes[t].size; }
+    Summary total(uint32_t t) const { return t == NIL ? Summary{} : m_nodes[t].total; }
+
+    void update(uint32_t t) {
+        Node& n = m_nodes[t];
+        n.size = 1 + size(n.left) + size(n.right);
+        n.total = combine(combine(total(n.left), n.line), total(n.right));
+    }
+
+    // Splits `t` into its first `k` lines and the rest.
+    void split(uint32_t t, size_t k, uint32_t& first, uint32_t& rest) {
+        if (t == NIL) {
+            first = rest = NIL;
+            return;
+        }
+        if (size(m_nodes[t].left) < k) {
+            uint32_t right = m_nodes[t].right;
+            split(right, k - size(m_nodes[t].left) - 1, right, rest);
+            m_nodes[t].right = right;
+            first = t;
+        } else {
+            uint32_t left = m_nodes[t].left;
+            split(left, k, first, left);
+            m_nodes[t].left = left;
+            rest = t;
+        }
+        update(t);
+    }
+
+    uint32_t merge(uint32_t a, uint32_t b) {
+        if (a == NIL) return b;
+        if (b == NIL) return a;
+        if (m_nodes[a].priority > m_nodes[b].priority) {
+            m_nodes[a].right = merge(m_nodes[a].right, b);
+            update(a);
+            return a;
+        }
+        m_nodes[b].left = merge(a, m_nodes[b].left);
+        update(b);
+        return b;
+    }
+
+    void release(uint32_t t) {
+        if (t == NIL) return;
+        release(m_nodes[t].left);
+        release(m_nodes[t].right);
+        m_free.push_back(t);
+    }
+
+    // A balanced tree of `lines`, built in linear time: the middle line is the
+    // root. The root's priority is random like any other node's; each child's
+    // is drawn from the upper half below its parent's, to agree with that
+    // shape without sinking far below the nodes merged in later.
+    uint32_t build(const Summary* lines, size_t count, uint32_t priority_cap) {
+        if (count == 0) return NIL;
+        size_t mid = count / 2;
+        uint32_t t;
+        if (!m_free.empty()) {
+            t = m_free.back();
+            m_free.pop_back();
+        } else {
+            t = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.emplace_back();
+        }
+        uint32_t priority = priority_cap == UINT32_MAX ? static_cast<uint32_t>(m_rng())
+                                                       : priority_cap / 2 + static_cast<uint32_t>(m_rng() % (priority_cap / 2 + 1));
+        m_nodes[t].line = lines[mid];
+        m_nodes[t].priority = priority;
+        m_nodes[t].left = build(lines, mid, priority);
+        m_nodes[t].right = build(lines + mid + 1, count - mid - 1, priority);
+        update(t);
+        return t;
+    }
+
+    void replace(size_t first, size_t count, const std::vector<Summary>& lines) {
+        uint32_t before, middle, after;
+        split(m_root, first, before, middle);
+        split(middle, count, middle, after);
+        release(middle);
+        uint32_t added = build(lines.data(), lines.size(), UINT32_MAX);
+        m_root = merge(merge(before, added), after);
+    }
+
+    // The first line after `line` where the depth, starting `depth` levels
+    // inside, falls back to zero. `level` is set to the depth change over
+    // the lines in between.
+    std::optional<size_t> line_closing(size_t line, int32_t depth, int32_t& level) const {
+        level = 0;
+        return find_forward(m_root, 0, line + 1, level, depth);
+    }
+
+    // Searches the lines of subtree `t` (the first of which is line `base`)
+    // from line `from` on. `level` is the depth change over the lines
+    // already passed, and is advanced past every line searched in vain.
+    std::optional<size_t> find_forward(uint32_t t, size_t base, size_t from, int32_t& level, int32_t depth) const {
+        if (t == NIL || base + size(t) <= from) return std::nullopt;
+        const Node& n = m_nodes[t];
+        if (base >= from && level + n.total.min_prefix > -depth) { // Nowhere in here
+            level += n.total.net;
+            return std::nullopt;
+        }
+        if (auto found = find_forward(n.left, base, from, level, depth)) return found;
+        size_t here = base + size(n.left);
+        if (here >= from) {
+            if (level + n.line.min_prefix <= -depth) return here;
+            level += n.line.net;
+        }
+        return find_forward(n.right, here + 1, from, level, depth);
+    }
+
+    // The last line before `line` where the depth, read backwards with
+    // `depth` closes unmatched, rises back to zero. `level` is as above.
+    std::optional<size_t> line_opening(size_t line, int32_t depth, int32_t& level) const {
+        level = 0;
+        return find_backward(m_root, 0, line, level, depth);
+    }
+
+    // find_forward() in reverse, over the lines of `t` before line `to`.
+    std::optional<size_t> find_backward(uint32_t t, size_t base, size_t to, int32_t& level, int32_t depth) const {
+        if (t == NIL || base >= to) return std::nullopt;
+        const Node& n = m_nodes[t];
+        if (base + size(t) <= to && level + n.total.max_suffix < depth) {
+            level += n.total.net;
+            return std::nullopt;
+        }
+        size_t here = base + size(n.left);
+        if (auto found = find_backward(n.right, here + 1, to, level, depth)) return found;
+        if (here < to) {
+            if (level + n.line.max_suffix >= depth) return here;
+            level += n.line.net;
+        }
+        return find_backward(n.left, base, to, level, depth);
+    }
+
+    std::optional<Position> match_forward(const Document& document, Position at) const {
+        int32_t depth = 0;
+        std::optional<Position> found;
+        for_each_bracket(document.line(at.line), [&](size_t column, char c) {
+            if (column < at.column || found) return;
+            depth += is_open(c) ? 1 : -1;
+            if (depth == 0) found = Position{at.line, column};
+        });
+        if (found) return found;
+        int32_t between;
+        auto line = line_closing(at.line, depth, between);
+        if (!line) return std::nullopt;
+        int32_t level = depth + between;
+        for_each_bracket(document.line(*line), [&](size_t column, char c) {
+            if (found) return;
+            level += is_open(c) ? 1 : -1;
+            if (level == 0) found = Position{*line, column};
+        });
+        return found;
+    }
+
+    std::optional<Position> match_backward(const Document& document, Position at) const {
+        std::vector<size_t> opens; // Unclosed opens before `at` on its line
+        int32_t depth = 1;         // Closes waiting for an open, the one at `at` included
+        for_each_bracket(document.line(at.line), [&](size_t column, char c) {
+            if (column >= at.column) return;
+            if (is_open(c)) opens.push_back(column);
+            else if (!opens.empty()) opens.pop_back();
+            else depth++;
+        });
+        if (!opens.empty()) return Position{at.line, opens.back()};
+        return open_before(document, {at.line, 0}, depth);
+    }
+
+    // The open bracket before `from` (on an earlier line) that `depth` levels
+    // of unmatched closes, starting at `from`, lead back to.
+    std::optional<Position> open_before(const Document& document, Position from, int32_t depth) const {
+        int32_t between;
+        auto line = line_opening(from.line, depth, between);
+        if (!line) return std::nullopt;
+        std::vector<std::pair<size_t, char>> brackets;
+        for_each_bracket(document.line(*line), [&](size_t column, char c) { brackets.push_back({column, c}); });
+        int32_t level = depth - between;
+        for (size_t k = brackets.size(); k-- > 0;) {
+            level += is_open(brackets[k].second) ? -1 : 1;
+            if (level == 0) return Position{*line, brackets[k].first};
+        }
+        return std::nullopt;
+    }
+};
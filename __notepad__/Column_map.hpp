@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "../__compiler__/Utf8.hpp"
+
+// Where each character of a line lands on screen. A character here is a
+// grapheme cluster: a base code point and the marks, joiners and selectors
+// that attach to it, which the terminal draws in one cell or, for East
+// Asian wide characters and emoji, two. Tabs reach the next multiple of 8
+// and other control bytes take two cells (ncurses draws them as ^X).
+// Malformed UTF-8 bytes count one cell each.
+//
+// A line of printable ASCII keeps no map at all: column and byte offset are
+// the same. Other lines keep the byte offset and column of every cluster,
+// so moving between them is a binary search.
+
+// Decodes the code point at text[i] into `cp`; returns its length in bytes,
+// or 1 with U+FFFD for a malformed byte.
+inline size_t decode_utf8(std::string_view text, size_t i, uint32_t& cp) {
+    unsigned char lead = static_cast<unsigned char>(text[i]);
+    if (lead < 0x80) {
+        cp = lead;
+        return 1;
+    }
+    size_t length = utf8_sequence_length(text, i);
+    if (length == 0) {
+        cp = 0xFFFD;
+        return 1;
+    }
+    cp = lead & (0xFF >> (length + 1));
+    for (size_t k = 1; k < length; k++) cp = (cp << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3F);
+    return length;
+}
+
+// Code points drawn on top of the one before them: combining marks, Hangul
+// medial and final jamo, zero-width spaces and joiners, variation
+// selectors, emoji skin tones and tags.
+inline bool is_zero_width(uint32_t cp) {
+    static const uint32_t ranges[][2] = {
+        {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x05BF, 0x05BF}, {0x05C1, 0x05C2},
+        {0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x0610, 0x061A}, {0x064B, 0x065F}, {0x0670, 0x0670},
+        {0x06D6, 0x06DC}, {0x06DF, 0x06E4}, {0x06E7, 0x06E8}, {0x06EA, 0x06ED}, {0x0900, 0x0903},
+        {0x093A, 0x094F}, {0x0951, 0x0957}, {0x0962, 0x0963}, {0x0E31, 0x0E31}, {0x0E34, 0x0E3A},
+        {0x0E47, 0x0E4E}, {0x1160, 0x11FF}, {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x200B, 0x200F},
+        {0x202A, 0x202E}, {0x2060, 0x2064}, {0x20D0, 0x20FF}, {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F},
+        {0xFEFF, 0xFEFF}, {0x1F3FB, 0x1F3FF}, {0xE0000, 0xE0FFF},
+    };
+    if (cp < 0x0300) return false;
+    for (const auto& r : ranges) {
+        if (cp < r[0]) return false;
+        if (cp <= r[1]) return true;
+    }
+    return false;
+}
+
+// East Asian wide and fullwidth code points, and the emoji drawn wide.
+inline bool is_wide(uint32_t cp) {
+    static const uint32_t ranges[][2] = {
+        {0x1100, 0x115F},   {0x231A, 0x231B},   {0x2329, 0x232A},   {0x23E9, 0x23EC},   {0x23F0, 0x23F0},
+        {0x23F3, 0x23F3},   {0x25FD, 0x25FE},   {0x2614, 0x2615},   {0x2648, 0x2653},   {0x267F, 0x267F},
+        {0x2693, 0x2693},   {0x26A1, 0x26A1},   {0x26AA, 0x26AB},   {0x26BD, 0x26BE},   {0x26C4, 0x26C5},
+        {0x26CE, 0x26CE},   {0x26D4, 0x26D4},   {0x26EA, 0x26EA},   {0x26F2, 0x26F3},   {0x26F5, 0x26F5},
+        {0x26FA, 0x26FA},   {0x26FD, 0x26FD},   {0x2705, 0x2705},   {0x270A, 0x270B},   {0x2728, 0x2728},
+        {0x274C, 0x274C},   {0x274E, 0x274E},   {0x2753, 0x2755},   {0x2757, 0x2757},   {0x2795, 0x2797},
+        {0x27B0, 0x27B0},   {0x27BF, 0x27BF},   {0x2B1B, 0x2B1C},   {0x2B50, 0x2B50},   {0x2B55, 0x2B55},
+        {0x2E80, 0x303E},   {0x3041, 0x33FF},   {0x3400, 0x4DBF},   {0x4E00, 0x9FFF},   {0xA000, 0xA4CF},
+        {0xA960, 0xA97F},   {0xAC00, 0xD7A3},   {0xF900, 0xFAFF},   {0xFE10, 0xFE19},   {0xFE30, 0xFE6F},
+        {0xFF00, 0xFF60},   {0xFFE0, 0xFFE6},   {0x16FE0, 0x16FE4}, {0x17000, 0x18AFF}, {0x1B000, 0x1B2FF},
+        {0x1F004, 0x1F004}, {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A}, {0x1F200, 0x1F251},
+        {0x1F300, 0x1F64F}, {0x1F680, 0x1F6FF}, {0x1F900, 0x1F9FF}, {0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD},
+        {0x30000, 0x3FFFD},
+    };
+    if (cp < 0x1100) return false;
+    size_t lo = 0, hi = sizeof(ranges) / sizeof(ranges[0]);
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (cp > ranges[mid][1]) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < sizeof(ranges) / sizeof(ranges[0]) && cp >= ranges[lo][0];
+}
+
+inline bool is_regional_indicator(uint32_t cp) { return cp >= 0x1F1E6 && cp <= 0x1F1FF; }
+
+class Column_map {
+public:
+    Column_map() = default;
+
+    explicit Column_map(std::string_view line) {
+        bool plain = std::all_of(line.begin(), line.end(), [](char c) { return c >= 0x20 && c < 0x7F; });
+        if (plain) {
+            m_width = line.size();
+            return;
+        }
+        size_t column = 0;
+        for (size_t i = 0; i < line.size();) {
+            m_bytes.push_back(static_cast<uint32_t>(i));
+            m_columns.push_back(static_cast<uint32_t>(column));
+            uint32_t cp;
+            i += decode_utf8(line, i, cp);
+            if (cp == '\t') column += 8 - column % 8;
+            else if (cp < 0x20 || cp == 0x7F) column += 2;
+            else column += is_wide(cp) ? 2 : is_zero_width(cp) ? 0 : 1;
+            // Everything that attaches to the base goes with it.
+            bool flag = is_regional_indicator(cp);
+            while (i < line.size()) {
+                uint32_t next;
+                size_t length = decode_utf8(line, i, next);
+                if (is_zero_width(next)) {
+                    i += length;
+                    if (next == 0x200D && i < line.size()) i += decode_utf8(line, i, next); // Joined to what follows
+                } else if (flag && is_regional_indicator(next)) {
+                    i += length; // The second half of a flag
+                    flag = false;
+                } else {
+                    break;
+                }
+            }
+        }
+        m_width = column;
+        m_bytes.push_back(static_cast<uint32_t>(line.size()));
+        m_columns.push_back(static_cast<uint32_t>(column));
+    }
+
+    // Columns the whole line takes.
+    size_t width() const { return m_width; }
+
+    // The column where the character at byte `byte` starts; `byte` is the
+    // start of a character or the end of the line.
+    size_t column_of(size_t byte) const {
+        if (m_bytes.empty()) return byte;
+        return m_columns[std::upper_bound(m_bytes.begin(), m_bytes.end(), byte) - m_bytes.begin() - 1];
+    }
+
+    // The start of the character that covers `column`, or the line's end
+    // past its last column.
+    size_t byte_at(size_t column) const {
+        if (m_bytes.empty()) return std::min(column, m_width);
+        return m_bytes[std::upper_bound(m_columns.begin(), m_columns.end(), column) - m_columns.begin() - 1];
+    }
+
+    // The start of the character after / before the one at `byte`.
+    size_t next(size_t byte) const {
+        if (m_bytes.empty()) return byte + 1;
+        return *std::upper_bound(m_bytes.begin(), m_bytes.end(), byte);
+    }
+    size_t previous(size_t byte) const {
+        if (m_bytes.empty()) return byte - 1;
+        return *(std::lower_bound(m_bytes.begin(), m_bytes.end(), byte) - 1);
+    }
+
+private:
+    size_t m_width = 0;
+    std::vector<uint32_t> m_bytes;   // Start of each character, then the line's length
+    std::vector<uint32_t> m_columns; // Column of each, then the line's width
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Document.hpp"
+#include "Wrap_layout.hpp"
+
+// The cursors, kept in document order, one of them the primary that the
+// screen follows. An edit is made at every cursor in one pass down the
+// list: each line's new text is built once with all of its cursors'
+// changes, and each cursor's new position falls out of the same pass, so
+// no cursor's offset is fixed up again for the edits above it.
+//
+// Every edit replaces only the lines its cursors touch, as the runs of one
+// Document::replace_runs(): the document's lines, and what each index keeps
+// per line, are rebuilt once for the whole edit rather than shifted once
+// per cursor, and no index redoes the lines between cursors. So an edit
+// costs the same pass over the lines however many cursors make it.
+
+class Cursors {
+public:
+    Cursors() : m_at(1) {}
+
+    const std::vector<Position>& all() const { return m_at; }
+    size_t count() const { return m_at.size(); }
+    Position primary() const { return m_at[m_primary]; }
+
+    // Moves the primary cursor; the others stay.
+    void set_primary(Position at) {
+        m_at[m_primary] = at;
+        normalize();
+    }
+
+    // Adds a cursor at `at`, which becomes the primary.
+    void add(Position at) {
+        m_at.push_back(at);
+        m_primary = m_at.size() - 1;
+        normalize();
+    }
+
+    // Drops every cursor but the primary.
+    void keep_primary() {
+        m_at = {primary()};
+        m_primary = 0;
+    }
+
+    // Moves each cursor to fn(it, primary?); cursors that meet become one.
+    template <typename Fn>
+    void move_each(Fn&& fn) {
+        for (size_t i = 0; i < m_at.size(); i++) m_at[i] = fn(m_at[i], i == m_primary);
+        normalize();
+    }
+
+    // Inserts `text` at every cursor, leaving each after its copy.
+    void insert(Document& document, std::string_view text) {
+        std::vector<Line_run> runs;
+        for (size_t i = 0; i < m_at.size();) {
+            size_t line = m_at[i].line, j = i;
+            while (j < m_at.size() && m_at[j].line == line) j++;
+            const std::string& old = document.line(line);
+            std::string next;
+            next.reserve(old.size() + (j - i) * text.size());
+            size_t from = 0;
+            for (size_t k = i; k < j; k++) {
+                next.append(old, from, m_at[k].column - from);
+                next += text;
+                from = m_at[k].column;
+                m_at[k].column = next.size();
+            }
+            next.append(old, from);
+            runs.push_back({line, 1, {std::move(next)}});
+            i = j;
+        }
+        document.replace_runs(std::move(runs));
+    }
+
+    // Enter at every cursor: each line is cut at all of its cursors.
+    void split_lines(Document& document) {
+        std::vector<Line_run> runs;
+        for (size_t i = 0; i < m_at.size();) {
+            size_t line = m_at[i].line, j = i;
+            while (j < m_at.size() && m_at[j].line == line) j++;
+            const std::string& old = document.line(line);
+            std::vector<std::string> lines;
+            lines.reserve(j - i + 1);
+            size_t from = 0;
+            for (size_t k = i; k < j; k++) {
+                lines.push_back(old.substr(from, m_at[k].column - from));
+                from = m_at[k].column;
+                m_at[k] = {line + k + 1, 0}; // Each cursor before it adds a line too
+            }
+            lines.push_back(old.substr(from));
+            runs.push_back({line, 1, std::move(lines)});
+            i = j;
+        }
+        document.replace_runs(std::move(runs));
+    }
+
+    // Backspace at every cursor: deletes the character before each, or at
+    // the start of a line joins the line onto the one above.
+    void erase_before(Document& document, Wrap_layout& layout) {
+        // Worked out top down, since a line's cursors land after what is
+        // left of the line above.
+        std::vector<Line_run> runs;
+        size_t joined = 0; // Lines gone so far
+        for (size_t i = 0; i < m_at.size();) {
+            size_t line = m_at[i].line, j = i;
+            while (j < m_at.size() && m_at[j].line == line) j++;
+            bool join = m_at[i].column == 0 && line > 0;
+            std::string next = erase_in_line(document, layout, line, i, j);
+            size_t base = 0;
+            if (join && !runs.empty() && runs.back().first + runs.back().count == line) {
+                Line_run& above = runs.back(); // Already replacing the line above
+                base = above.lines.back().size();
+                above.lines.back() += next;
+                above.count++;
+            } else if (join) {
+                base = document.line(line - 1).size();
+                runs.push_back({line - 1, 2, {document.line(line - 1) + next}});
+            } else {
+                runs.push_back({line, 1, {std::move(next)}});
+            }
+            joined += join;
+            for (size_t k = i; k < j; k++) m_at[k] = {line - joined, base + m_at[k].column};
+            i = j;
+        }
+        document.replace_runs(std::move(runs));
+        normalize();
+    }
+
+private:
+    std::vector<Position> m_at; // In document order, no two the same
+    size_t m_primary = 0;
+
+    // Line `line` with the character before each cursor in [i, j) deleted,
+    // updating those cursors' columns; a cursor at column 0 is left there.
+    std::string erase_in_line(const Document& document, Wrap_layout& layout, size_t line, size_t i, size_t j) {
+        const std::string& old = document.line(line);
+        const Column_map& columns = layout.columns(document, line);
+        std::string next;
+        next.reserve(old.size());
+        size_t from = 0;
+        for (size_t k = i; k < j; k++) {
+            size_t column = m_at[k].column;
+            if (column == 0) continue;
+            size_t start = std::max(columns.previous(column), from); // Not into what an earlier cursor erased
+            next.append(old, from, start - from);
+            from = column;
+            m_at[k].column = next.size();
+        }
+        next.append(old, from);
+        return next;
+    }
+
+    // Restores document order and merges cursors that meet, keeping track
+    // of the primary.
+    void normalize() {
+        Position primary = m_at[m_primary];
+        if (!std::is_sorted(m_at.begin(), m_at.end())) std::sort(m_at.begin(), m_at.end());
+        m_at.erase(std::unique(m_at.begin(), m_at.end()), m_at.end());
+        m_primary = std::lower_bound(m_at.begin(), m_at.end(), primary) - m_at.begin();
+    }
+};
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// The text being edited, held as lines without their '\n'. The screen is
+// drawn from here, never read back. Every change goes through
+// replace_lines(), which tells the listeners which lines it replaced, so the
+// indexes kept over the text (symbols, brackets, layout) redo only those.
+// replace_runs() replaces several runs of lines at once, for an edit made at
+// many places: the lines are rebuilt in one pass, and listeners hear all the
+// runs in one call, so they too can rebuild what they keep per line once
+// rather than shift it for every run.
+//
+// Edits can also be batched, for running a macro: listeners registered as
+// batched then hear nothing until the batch ends (or flush() is called),
+// and then hear one edit covering every line the batch touched, as long as
+// its edits were next to or on top of each other. Listeners that must stay
+// current after each edit, like the layout the cursor moves by, are not
+// batched.
+
+struct Position {
+    size_t line = 0;
+    size_t column = 0; // Byte offset into the line
+};
+
+inline bool operator<(const Position& a, const Position& b) {
+    return a.line != b.line ? a.line < b.line : a.column < b.column;
+}
+inline bool operator==(const Position& a, const Position& b) { return a.line == b.line && a.column == b.column; }
+
+struct Line_edit {
+    size_t first;                        // First line replaced
+    std::vector<std::string> old_lines;  // What lines [first, first + old_lines.size()) held before
+    size_t new_count;                    // How many lines now stand in their place
+};
+
+// Edits heard together, top down. Each one's `first` counts the lines above
+// it as they are after the edits before it, so applying the edits in turn
+// gives the document as it now is.
+using Line_edits = std::vector<Line_edit>;
+
+// Lines [first, first + count) to be replaced with `lines`.
+struct Line_run {
+    size_t first;
+    size_t count;
+    std::vector<std::string> lines;
+};
+
+// Brings `per_line`, which holds an entry for each line of the document, in
+// step with `edits`, with fresh(i) making the entry for new line i. A lone
+// edit, or edits that keep their line counts, are made in place; otherwise
+// the entries are rebuilt in one pass.
+template <typename T, typename Fresh>
+void apply_edits(std::vector<T>& per_line, const Line_edits& edits, Fresh&& fresh) {
+    if (std::all_of(edits.begin(), edits.end(), [](const Line_edit& edit) { return edit.old_lines.size() == edit.new_count; })) {
+        for (const Line_edit& edit : edits) {
+            for (size_t i = edit.first; i < edit.first + edit.new_count; i++) per_line[i] = fresh(i);
+        }
+        return;
+    }
+    if (edits.size() == 1) {
+        const Line_edit& edit = edits.front();
+        auto first = per_line.begin() + edit.first;
+        size_t common = std::min(edit.old_lines.size(), edit.new_count);
+        if (edit.old_lines.size() > common) {
+            per_line.erase(first + common, first + edit.old_lines.size());
+        } else {
+            per_line.insert(first + common, edit.new_count - common, T{});
+        }
+        for (size_t i = edit.first; i < edit.first + edit.new_count; i++) per_line[i] = fresh(i);
+        return;
+    }
+    size_t removed = 0, added = 0;
+    for (const Line_edit& edit : edits) removed += edit.old_lines.size(), added += edit.new_count;
+    std::vector<T> next;
+    next.reserve(per_line.size() - removed + added);
+    size_t from = 0; // Next entry of `per_line` not yet moved or dropped
+    for (const Line_edit& edit : edits) {
+        size_t first = from + (edit.first - next.size()); // Where the edit starts in `per_line`
+        std::move(per_line.begin() + from, per_line.begin() + first, std::back_inserter(next));
+        for (size_t i = edit.first; i < edit.first + edit.new_count; i++) next.push_back(fresh(i));
+        from = first + edit.old_lines.size();
+    }
+    std::move(per_line.begin() + from, per_line.end(), std::back_inserter(next));
+    per_line = std::move(next);
+}
+
+class Document {
+public:
+    using Listener = std::function<void(const Document&, const Line_edits&)>;
+
+    Document() : m_lines(1) {}
+
+    // Replaces the whole text with the file's; false if it cannot be read.
+    bool load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(in, line)) lines.push_back(std::move(line));
+        if (lines.empty()) lines.emplace_back();
+        replace_lines(0, m_lines.size(), std::move(lines));
+        return true;
+    }
+
+    size_t line_count() const { return m_lines.size(); }
+    const std::string& line(size_t i) const { return m_lines[i]; }
+
+    void on_edit(Listener listener, bool batched = false) {
+        (batched ? m_batched : m_listeners).push_back(std::move(listener));
+    }
+
+    // Counts edits, to tell whether any were made.
+    size_t revision() const { return m_revision; }
+
+    // Batches nest: only the outermost end_batch() flushes.
+    void begin_batch() { m_batch_depth++; }
+    void end_batch() {
+        if (--m_batch_depth == 0) flush();
+    }
+
+    // Brings the batched listeners up to date, inside a batch or not.
+    void flush() {
+        if (!m_pending) return;
+        Line_edit edit = std::move(*m_pending);
+        m_pending.reset();
+        edit.old_lines.insert(edit.old_lines.begin(), std::make_move_iterator(m_pending_above.rbegin()),
+                              std::make_move_iterator(m_pending_above.rend()));
+        m_pending_above.clear();
+        Line_edits edits;
+        edits.push_back(std::move(edit));
+        for (const auto& listener : m_batched) listener(*this, edits);
+    }
+
+    // Replaces `count` lines starting at `first` with `lines`. The document
+    // always keeps at least one (possibly empty) line.
+    void replace_lines(size_t first, size_t count, std::vector<std::string> lines) {
+        // An edit away from the batch's pending one sends that out first,
+        // while its lines are still where it says.
+        if (m_pending && (first > m_pending->first + m_pending->new_count || first + count < m_pending->first)) flush();
+        Line_edit edit{first, {}, lines.size()};
+        edit.old_lines.assign(std::make_move_iterator(m_lines.begin() + first),
+                              std::make_move_iterator(m_lines.begin() + first + count));
+        // Overwrite in place what both have, so that only a change in the
+        // number of lines shifts the lines after it.
+        size_t common = std::min(count, lines.size());
+        std::move(lines.begin(), lines.begin() + common, m_lines.begin() + first);
+        if (count > common) {
+            m_lines.erase(m_lines.begin() + first + common, m_lines.begin() + first + count);
+        } else {
+            m_lines.insert(m_lines.begin() + first + common, std::make_move_iterator(lines.begin() + common),
+                           std::make_move_iterator(lines.end()));
+        }
+        if (m_lines.empty()) {
+            m_lines.emplace_back();
+            edit.new_count = 1;
+        }
+        Line_edits edits;
+        edits.push_back(std::move(edit));
+        announce(std::move(edits));
+    }
+
+    // Replaces each of `runs`, which are in order and do not overlap, all
+    // counted as the lines are now. The lines are rebuilt once, however
+    // many runs there are, and listeners hear the runs as one Line_edits.
+    // Inside a batch, several runs are not merged with the batch's other
+    // edits: the pending edit is sent out first and the runs go with it.
+    void replace_runs(std::vector<Line_run> runs) {
+        if (runs.size() == 1) {
+            replace_lines(runs.front().first, runs.front().count, std::move(runs.front().lines));
+            return;
+        }
+        if (runs.empty()) return;
+        if (m_pending) flush();
+        Line_edits edits;
+        edits.reserve(runs.size());
+        bool same_counts = std::all_of(runs.begin(), runs.end(), [](const Line_run& run) { return run.count == run.lines.size(); });
+        if (same_counts) {
+            // No line moves: overwrite each run where it is.
+            for (Line_run& run : runs) {
+                Line_edit edit{run.first, {}, run.count};
+                edit.old_lines.reserve(run.count);
+                for (size_t i = 0; i < run.count; i++) {
+                    edit.old_lines.push_back(std::move(m_lines[run.first + i]));
+                    m_lines[run.first + i] = std::move(run.lines[i]);
+                }
+                edits.push_back(std::move(edit));
+            }
+        } else {
+            size_t added = 0, removed = 0;
+            for (const Line_run& run : runs) removed += run.count, added += run.lines.size();
+            std::vector<std::string> lines;
+            lines.reserve(m_lines.size() - removed + added);
+            size_t from = 0; // Next line of m_lines not yet moved
+            for (Line_run& run : runs) {
+                std::move(m_lines.begin() + from, m_lines.begin() + run.first, std::back_inserter(lines));
+                Line_edit edit{lines.size(), {}, run.lines.size()};
+                edit.old_lines.assign(std::make_move_iterator(m_lines.begin() + run.first),
+                                      std::make_move_iterator(m_lines.begin() + run.first + run.count));
+                std::move(run.lines.begin(), run.lines.end(), std::back_inserter(lines));
+                from = run.first + run.count;
+                edits.push_back(std::move(edit));
+            }
+            std::move(m_lines.begin() + from, m_lines.end(), std::back_inserter(lines));
+            m_lines = std::move(lines);
+            if (m_lines.empty()) {
+                m_lines.emplace_back();
+                edits.back().new_count = 1;
+            }
+        }
+        announce(std::move(edits));
+    }
+
+    // The position moved onto the text: a line that exists, a column in it.
+    Position clamp(Position at) const {
+        if (at.line >= m_lines.size()) at.line = m_lines.size() - 1;
+        if (at.column > m_lines[at.line].size()) at.column = m_lines[at.line].size();
+        return at;
+    }
+
+    // Each edit below returns where the cursor goes afterwards.
+    Position insert(Position at, std::string_view text) {
+        std::string line = m_lines[at.line];
+        line.insert(at.column, text);
+        replace_lines(at.line, 1, {std::move(line)});
+        return {at.line, at.column + text.size()};
+    }
+
+    // Enter: the text after the cursor moves to a new line below.
+    Position split_line(Position at) {
+        const std::string& line = m_lines[at.line];
+        replace_lines(at.line, 1, {line.substr(0, at.column), line.substr(at.column)});
+        return {at.line + 1, 0};
+    }
+
+    // Backspace: deletes the `bytes` bytes before the cursor, or at the
+    // start of a line joins it onto the previous one.
+    Position erase_before(Position at, size_t bytes = 1) {
+        if (at.column > 0) {
+            std::string line = m_lines[at.line];
+            line.erase(at.column - bytes, bytes);
+            replace_lines(at.line, 1, {std::move(line)});
+            return {at.line, at.column - bytes};
+        }
+        if (at.line == 0) return at;
+        size_t column = m_lines[at.line - 1].size();
+        replace_lines(at.line - 1, 2, {m_lines[at.line - 1] + m_lines[at.line]});
+        return {at.line - 1, column};
+    }
+
+private:
+    std::vector<std::string> m_lines;
+    std::vector<Listener> m_listeners;
+    std::vector<Listener> m_batched;
+    size_t m_batch_depth = 0;
+    std::optional<Line_edit> m_pending; // The batch's edits so far, as one
+    std::vector<std::string> m_pending_above; // Its old lines above `old_lines`, nearest first, until flush()
+    size_t m_revision = 0;
+
+    // Tells the listeners about `edits`, just made; a lone edit inside a
+    // batch is held back for the batched ones, to be merged.
+    void announce(Line_edits edits) {
+        m_revision++;
+        for (const auto& listener : m_listeners) listener(*this, edits);
+        if (m_batch_depth == 0 || edits.size() > 1) {
+            for (const auto& listener : m_batched) listener(*this, edits);
+        } else {
+            merge(std::move(edits.front()));
+        }
+    }
+
+    // Folds `edit`, just made, into the pending one, which it overlaps or
+    // touches. Their spans are taken together, with the lines from either
+    // that the other did not touch. Lines joined on above the span go into
+    // m_pending_above, so a macro working up the file appends too.
+    void merge(Line_edit edit) {
+        if (!m_pending) {
+            m_pending = std::move(edit);
+            return;
+        }
+        Line_edit& pending = *m_pending;
+        size_t edit_end = edit.first + edit.old_lines.size();    // Where `edit` ended, before it was made
+        size_t pending_end = pending.first + pending.new_count;  // Likewise for the pending span
+        size_t first = std::min(edit.first, pending.first), end = std::max(edit_end, pending_end);
+        // Line i as it was before `edit`.
+        auto before_edit = [&](size_t i) -> const std::string& {
+            if (i < edit.first) return m_lines[i];
+            if (i < edit_end) return edit.old_lines[i - edit.first];
+            return m_lines[i - edit.old_lines.size() + edit.new_count];
+        };
+        for (size_t i = pending_end; i < end; i++) pending.old_lines.push_back(before_edit(i));
+        for (size_t i = pending.first; i-- > first;) m_pending_above.push_back(before_edit(i));
+        pending.first = first;
+        pending.new_count = end - first - edit.old_lines.size() + edit.new_count;
+    }
+};
@@ -0,0 +1,327 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Document.hpp"
+
+// Noticing when another program rewrites the file being edited, and taking
+// in only what it changed.
+//
+// File_watch asks inotify about the file's directory, so a save that writes
+// a new file and renames it over the old one is seen as well as one that
+// rewrites it in place. File_sync keeps a hash of every line of the
+// document, updated with each edit, and of every line of the file as it was
+// last loaded (the base). A reload reads the file and walks it from the
+// front, then from the back, hashing each line and comparing it with the
+// base's until they differ. The lines in between are diffed by hash against
+// the base, and so is the document, which gives what the file changed and
+// what the user changed since. Only the file's runs that the user's do not
+// overlap are copied out and put into the document, all as one
+// replace_runs(), so the user's edits survive a save made elsewhere. The
+// indexes over the document (and the cursor) see ordinary edits of those
+// lines, and the unchanged rest of the file is only ever hashed, never split
+// into strings.
+
+class File_watch {
+public:
+    explicit File_watch(const std::string& path) {
+        size_t slash = path.rfind('/');
+        std::string directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        m_name = slash == std::string::npos ? path : path.substr(slash + 1);
+        m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_fd >= 0 && inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+    ~File_watch() {
+        if (m_fd >= 0) close(m_fd);
+    }
+    File_watch(const File_watch&) = delete;
+    File_watch& operator=(const File_watch&) = delete;
+
+    // Whether the file was written or replaced since the last call. Never
+    // blocks; always false if inotify is unavailable.
+    bool changed() {
+        bool seen = false;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while (m_fd >= 0 && (length = read(m_fd, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t at = 0; at < length;) {
+                auto* event = reinterpret_cast<const inotify_event*>(buffer + at);
+                if (event->len && m_name == event->name) seen = true;
+                at += sizeof(inotify_event) + event->len;
+            }
+        }
+        return seen;
+    }
+
+private:
+    int m_fd = -1;
+    std::string m_name;
+};
+
+class File_sync {
+public:
+    // One run of lines a reload replaced: [first, first + old_count) became
+    // [first, first + new_count).
+    struct Reloaded {
+        size_t first;
+        size_t old_count;
+        size_t new_count;
+    };
+
+    // Keeps the line hashes in step with `document`, a batch at a time.
+    void attach(Document& document) {
+        document.on_edit([this](const Document& doc, const Line_edits& edits) {
+            apply_edits(m_hashes, edits, [&](size_t i) { return hash(doc.line(i)); });
+        }, true);
+    }
+
+    // Loads the file at `path` into `document`, as Document::load() does,
+    // and takes its lines as the base that reload() merges against.
+    bool load(Document& document, const std::string& path) {
+        if (!document.load(path)) return false;
+        m_base = m_hashes;
+        return true;
+    }
+
+    // Takes in what changed in the file at `path` since it was last loaded
+    // or reloaded, keeping the edits made in `document` since then. Runs of
+    // lines the file changed are applied where the document still has them
+    // as they were; where the document's edits overlap a run, the edits are
+    // kept and the run is not applied. Returns the runs applied, top down,
+    // each counted after the ones before it (so a line number is carried
+    // across by applying them in turn); empty if the file cannot be read or
+    // nothing is applied.
+    std::vector<Reloaded> reload(Document& document, const std::string& path) {
+        // Read, not mapped: a file cut short while mapped would fault on the
+        // pages past its new end.
+        std::string file;
+        if (!read_file(path, file)) return {};
+        const char* data = file.data();
+
+        // The file's lines are those of [0, end) split at '\n', as load() reads them.
+        size_t end = !file.empty() && file.back() == '\n' ? file.size() - 1 : file.size();
+        size_t lines = m_base.size();
+
+        // Lines the same as the base from the front. `more` says whether file lines remain from `from` on.
+        size_t same_front = 0, from = 0;
+        bool more = true;
+        while (more && same_front < lines) {
+            auto newline = static_cast<const char*>(std::memchr(data + from, '\n', end - from));
+            size_t stop = newline ? newline - data : end;
+            if (hash({data + from, stop - from}) != m_base[same_front]) break;
+            same_front++;
+            if (newline) from = stop + 1;
+            else more = false;
+        }
+        // Same lines from the back, not reaching back into those.
+        size_t same_back = 0, to = end;
+        while (more && same_front + same_back < lines) {
+            auto newline = static_cast<const char*>(memrchr(data + from, '\n', to - from));
+            size_t start = newline ? newline - data + 1 : from;
+            if (hash({data + start, to - start}) != m_base[lines - 1 - same_back]) break;
+            same_back++;
+            if (newline) to = start - 1;
+            else more = false;
+        }
+
+        // The file's lines in between, as spans of what was read and hashes.
+        std::vector<std::string_view> middle;
+        std::vector<uint64_t> middle_hashes;
+        if (more) {
+            for (size_t at = from;;) {
+                auto newline = static_cast<const char*>(std::memchr(data + at, '\n', to - at));
+                size_t stop = newline ? newline - data : to;
+                middle.emplace_back(data + at, stop - at);
+                middle_hashes.push_back(hash(middle.back()));
+                if (!newline) break;
+                at = stop + 1;
+            }
+        }
+
+        // What the file changed, and what the document changed, both
+        // against the base.
+        size_t old_count = lines - same_front - same_back;
+        std::vector<Hunk> theirs;
+        if (old_count || !middle.empty()) {
+            theirs = diff(m_base.data() + same_front, old_count, middle_hashes.data(), middle.size());
+        }
+        std::vector<Hunk> ours = changes(m_base, m_hashes);
+
+        // Each of the file's runs that none of the document's overlap is
+        // applied where the document's runs before it have moved it to.
+        std::vector<Line_run> runs;
+        std::vector<Reloaded> applied;
+        size_t k = 0, added = 0, removed = 0; // Over the document's runs wholly before the file's run
+        for (const Hunk& h : theirs) {
+            size_t first = same_front + h.old_start, last = first + h.old_count;
+            for (; k < ours.size() && ours[k].old_start + ours[k].old_count <= first && !overlap(ours[k], first, last); k++) {
+                added += ours[k].new_count;
+                removed += ours[k].old_count;
+            }
+            bool kept = false; // Whether the document's edits win here
+            for (size_t j = k; j < ours.size() && ours[j].old_start <= last && !kept; j++) kept = overlap(ours[j], first, last);
+            if (kept) continue;
+            runs.push_back({first + added - removed, h.old_count,
+                            {middle.begin() + h.new_start, middle.begin() + h.new_start + h.new_count}});
+        }
+        size_t before = document.line_count(), net = before;
+        for (const Line_run& run : runs) {
+            applied.push_back({0, run.count, run.lines.size()});
+            net += run.lines.size() - run.count;
+        }
+        // Counted after the runs before each, as the document hears them.
+        for (size_t i = 0, shift_in = 0, shift_out = 0; i < runs.size(); i++) {
+            applied[i].first = runs[i].first + shift_in - shift_out;
+            shift_in += applied[i].new_count;
+            shift_out += applied[i].old_count;
+        }
+        document.replace_runs(std::move(runs));
+        // The document keeps at least one line.
+        if (!applied.empty() && document.line_count() > net) applied.back().new_count += document.line_count() - net;
+
+        // The file as read is the base from now on.
+        m_base.erase(m_base.begin() + same_front, m_base.begin() + same_front + old_count);
+        m_base.insert(m_base.begin() + same_front, middle_hashes.begin(), middle_hashes.end());
+        return applied;
+    }
+
+private:
+    std::vector<uint64_t> m_hashes = std::vector<uint64_t>(1, hash("")); // One per document line
+    std::vector<uint64_t> m_base = m_hashes; // One per line of the file as last loaded or reloaded
+
+    static uint64_t hash(std::string_view line) { return std::hash<std::string_view>{}(line); }
+
+    // Reads the whole file at `path` into `out`, stopping early if it is cut
+    // short meanwhile; false if it cannot be read.
+    static bool read_file(const std::string& path, std::string& out) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return false;
+        }
+        out.resize(static_cast<size_t>(st.st_size));
+        size_t done = 0;
+        while (done < out.size()) {
+            ssize_t got = pread(fd, &out[done], out.size() - done, static_cast<off_t>(done));
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0) {
+                close(fd);
+                return false;
+            }
+            if (got == 0) break;
+            done += static_cast<size_t>(got);
+        }
+        close(fd);
+        out.resize(done);
+        return true;
+    }
+
+    // Lines [old_start, old_start + old_count) of `a` become lines
+    // [new_start, new_start + new_count) of `b`.
+    struct Hunk {
+        size_t old_start;
+        size_t old_count;
+        size_t new_start;
+        size_t new_count;
+    };
+
+    // Whether `h`, a run of the document's changes, touches lines
+    // [first, last) of the base, which another run changes. Runs that only
+    // meet end to start do not, unless both put lines in at the same place.
+    static bool overlap(const Hunk& h, size_t first, size_t last) {
+        size_t h_last = h.old_start + h.old_count;
+        if (h.old_count == 0 && first == last) return h.old_start == first;
+        if (h.old_count == 0) return first < h.old_start && h.old_start < last;
+        if (first == last) return h.old_start < first && first < h_last;
+        return std::max(first, h.old_start) < std::min(last, h_last);
+    }
+
+    // The runs where `b` differs from `a`: the same lines at either end are
+    // passed over, and the lines in between diffed.
+    static std::vector<Hunk> changes(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+        size_t front = 0, back = 0;
+        while (front < a.size() && front < b.size() && a[front] == b[front]) front++;
+        while (back < a.size() - front && back < b.size() - front && a[a.size() - 1 - back] == b[b.size() - 1 - back]) back++;
+        size_t n = a.size() - front - back, m = b.size() - front - back;
+        if (n == 0 && m == 0) return {};
+        std::vector<Hunk> hunks = diff(a.data() + front, n, b.data() + front, m);
+        for (Hunk& h : hunks) h.old_start += front, h.new_start += front;
+        return hunks;
+    }
+
+    // The most differences diff() looks for before giving up. Its trace
+    // takes about MAX_DIFFERENCES^2 entries.
+    static constexpr int64_t MAX_DIFFERENCES = 1024;
+
+    // The runs of lines that differ between `a` and `b`, in order, from
+    // Myers's greedy shortest-edit-script search: it follows matching lines
+    // along each diagonal, so it costs about (n + m) times the number of
+    // differences. Past MAX_DIFFERENCES, everything is one run.
+    static std::vector<Hunk> diff(const uint64_t* a, size_t n, const uint64_t* b, size_t m) {
+        if (n == 0 || m == 0) return {{0, n, 0, m}};
+        int64_t N = static_cast<int64_t>(n), M = static_cast<int64_t>(m);
+        int64_t limit = std::min<int64_t>(N + M, MAX_DIFFERENCES);
+        std::vector<int64_t> v(2 * limit + 3, 0); // Furthest x on diagonal k, at v[k + limit + 1]
+        std::vector<std::vector<int64_t>> trace;  // v over diagonals [-d, d] after each d
+        auto at = [&](int64_t k) -> int64_t& { return v[k + limit + 1]; };
+        int64_t found = -1;
+        for (int64_t d = 0; d <= limit && found < 0; d++) {
+            for (int64_t k = -d; k <= d; k += 2) {
+                int64_t x = k == -d || (k != d && at(k - 1) < at(k + 1)) ? at(k + 1) : at(k - 1) + 1;
+                int64_t y = x - k;
+                while (x < N && y < M && a[x] == b[y]) x++, y++;
+                at(k) = x;
+                if (x >= N && y >= M) found = d;
+            }
+            trace.emplace_back(v.begin() + (limit + 1 - d), v.begin() + (limit + 2 + d));
+        }
+        if (found < 0) return {{0, n, 0, m}};
+
+        // Walk back through the trace, marking the lines that stay.
+        std::vector<bool> a_kept(n, true), b_kept(m, true);
+        int64_t x = N, y = M;
+        for (int64_t d = found; d > 0; d--) {
+            const std::vector<int64_t>& previous = trace[d - 1]; // Diagonals [-(d-1), d-1]
+            auto prev = [&](int64_t k) { return previous[k + d - 1]; };
+            int64_t k = x - y;
+            bool down = k == -d || (k != d && prev(k - 1) < prev(k + 1));
+            int64_t prev_k = down ? k + 1 : k - 1;
+            int64_t prev_x = prev(prev_k), prev_y = prev_x - prev_k;
+            if (down) b_kept[prev_y] = false; // A line of b put in
+            else a_kept[prev_x] = false;      // A line of a taken out
+            x = prev_x;
+            y = prev_y;
+        }
+
+        std::vector<Hunk> hunks;
+        for (size_t i = 0, j = 0; i < n || j < m;) {
+            if (i < n && j < m && a_kept[i] && b_kept[j]) {
+                i++, j++;
+                continue;
+            }
+            Hunk h{i, 0, j, 0};
+            while (i < n && !a_kept[i]) i++;
+            while (j < m && !b_kept[j]) j++;
+            h.old_count = i - h.old_start;
+            h.new_count = j - h.new_start;
+            hunks.push_back(h);
+        }
+        return hunks;
+    }
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <iterator>
+#include <map>
+#include <optional>
+#include <utility>
+
+#include "Document.hpp"
+
+// Folded blocks. A fold keeps its first line on screen and hides the lines
+// after it, through its last. Folds never overlap: folding a block removes
+// the folds inside it. An edit that touches a fold opens it, and folds below
+// the edit move with their lines.
+
+class Folds {
+public:
+    // Keeps the folds in step with `document`.
+    void attach(Document& document) {
+        document.on_edit([this](const Document&, const Line_edits& edits) {
+            // One pass down the folds and the edits together. `added` and
+            // `removed` count the lines the edits passed so far put in and
+            // took out, so edits[k] began at line edits[k].first + removed - added.
+            std::map<size_t, size_t> moved;
+            size_t k = 0, added = 0, removed = 0;
+            for (auto [first, last] : m_folds) {
+                for (; k < edits.size() && edits[k].first + removed - added + edits[k].old_lines.size() <= first; k++) {
+                    added += edits[k].new_count;
+                    removed += edits[k].old_lines.size();
+                }
+                if (k == edits.size() || last < edits[k].first + removed - added) {
+                    moved.emplace(first + added - removed, last + added - removed);
+                }
+            }
+            m_folds = std::move(moved);
+        });
+    }
+
+    // Folds lines [first, last], or opens the fold if it is already folded.
+    void toggle(size_t first, size_t last) {
+        auto it = m_folds.find(first);
+        if (it != m_folds.end()) {
+            m_folds.erase(it);
+            return;
+        }
+        m_folds.erase(m_folds.lower_bound(first), m_folds.upper_bound(last));
+        if (auto outer = folding(first)) m_folds.erase(outer->first); // Cannot fold inside a fold
+        m_folds.emplace(first, last);
+    }
+
+    // The fold starting on `line`, if any.
+    std::optional<std::pair<size_t, size_t>> starting(size_t line) const {
+        auto it = m_folds.find(line);
+        if (it == m_folds.end()) return std::nullopt;
+        return *it;
+    }
+
+    // The fold that hides `line`, if any.
+    std::optional<std::pair<size_t, size_t>> folding(size_t line) const {
+        auto it = m_folds.upper_bound(line);
+        if (it == m_folds.begin()) return std::nullopt;
+        --it;
+        if (it->first < line && line <= it->second) return *it;
+        return std::nullopt;
+    }
+
+    void open(size_t first) { m_folds.erase(first); }
+
+    // The visible line after / before `line`, which may be past the ends.
+    size_t next_visible(size_t line) const {
+        auto fold = starting(line);
+        return fold ? fold->second + 1 : line + 1;
+    }
+    size_t previous_visible(size_t line) const {
+        if (line == 0) return 0;
+        auto fold = folding(line - 1);
+        return fold ? fold->first : line - 1;
+    }
+
+private:
+    std::map<size_t, size_t> m_folds; // First line -> last line
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cerrno>
+#include <ncurses.h>
+#include <poll.h>
+#include <string>
+#include <unistd.h>
+
+// Keys read straight from the terminal, so that reading them never goes
+// through ncurses, which the render thread owns. The escape sequences for
+// the arrows (and Home, End and Delete) come back as ncurses's KEY_ codes,
+// in either of the forms terminals send them.
+
+// A key as the editor takes it: a printable one carries the whole UTF-8
+// character it began.
+struct Key {
+    int code;
+    std::string text;
+};
+
+class Key_reader {
+public:
+    explicit Key_reader(int fd) : m_fd(fd) {}
+
+    // The next key, or a key with code ERR if none comes within
+    // `timeout_ms` (or an unknown escape sequence came), or KEY_RESIZE if a
+    // signal, which the editor only expects on a resize, cut the wait short.
+    Key next(int timeout_ms) {
+        int c = byte(timeout_ms);
+        if (c == INTERRUPTED) return {KEY_RESIZE, {}};
+        if (c == NONE) return {ERR, {}};
+        if (c == 27) return {escape(), {}};
+        if (c < 32 || c >= 256) return {c, {}};
+        // A UTF-8 character arrives as its lead byte and then the rest.
+        std::string typed(1, static_cast<char>(c));
+        size_t length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        while (typed.size() < length) {
+            int next = byte(SEQUENCE_MS);
+            if (next < 0) break;
+            if ((next & 0xC0) != 0x80) {
+                m_begin--; // Not part of it: leave it for the next key
+                break;
+            }
+            typed += static_cast<char>(next);
+        }
+        return {c, typed};
+    }
+
+private:
+    static constexpr int NONE = -1;
+    static constexpr int INTERRUPTED = -2;
+    static constexpr int SEQUENCE_MS = 25; // The rest of a sequence comes at once; Escape alone does not
+
+    int m_fd;
+    unsigned char m_buffer[256];
+    size_t m_begin = 0, m_end = 0;
+
+    int byte(int timeout_ms) {
+        if (m_begin == m_end) {
+            pollfd in{m_fd, POLLIN, 0};
+            int ready = poll(&in, 1, timeout_ms);
+            if (ready < 0) return errno == EINTR ? INTERRUPTED : NONE;
+            if (ready == 0) return NONE;
+            ssize_t length = read(m_fd, m_buffer, sizeof(m_buffer));
+            if (length <= 0) return NONE;
+            m_begin = 0;
+            m_end = static_cast<size_t>(length);
+        }
+        return m_buffer[m_begin++];
+    }
+
+    // After ESC: CSI ("ESC [") and SS3 ("ESC O") sequences, or Escape itself.
+    int escape() {
+        int c = byte(SEQUENCE_MS);
+        if (c < 0) return 27;
+        if (c != '[' && c != 'O') {
+            m_begin--; // Alt+key: Escape, then the key
+            return 27;
+        }
+        int parameter = 0;
+        while ((c = byte(SEQUENCE_MS)) >= '0' && c <= '9') parameter = parameter * 10 + (c - '0');
+        // Later parameters (modifiers) are skipped.
+        while (c >= 0 && ((c >= '0' && c <= '9') || c == ';')) c = byte(SEQUENCE_MS);
+        switch (c) {
+            case 'A': return KEY_UP;
+            case 'B': return KEY_DOWN;
+            case 'C': return KEY_RIGHT;
+            case 'D': return KEY_LEFT;
+            case 'H': return KEY_HOME;
+            case 'F': return KEY_END;
+            case '~': return parameter == 3 ? KEY_DC : ERR;
+            default: return ERR;
+        }
+    }
+};
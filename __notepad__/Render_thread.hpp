@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <memory>
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdexcept>
+#include <string>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Spsc_queue.hpp"
+
+// What one screen shows, complete, so that drawing it needs nothing else:
+// the editing thread builds a Frame from the document and hands it over,
+// and never touches it again.
+struct Frame {
+    struct Row {
+        std::string text;         // Tabs already expanded
+        int width = 0;            // In columns
+        std::string marker;       // Drawn dimmed after the text (a fold's)
+        std::vector<int> cursors; // Columns of the cursors other than the primary
+    };
+    int rows = 0, cols = 0; // The terminal's size it was laid out for
+    std::vector<Row> lines; // From the top; at most rows - 1
+    std::string status;
+    int cursor_y = 0, cursor_x = 0; // The primary cursor
+};
+
+// Drawing on its own thread, so a slow terminal (a remote one, a large
+// redraw) never holds up typing. This thread is the only one that calls
+// ncurses once it has started. Frames reach it through a lock-free
+// single-producer, single-consumer queue, and an eventfd wakes it. Each
+// time it wakes it takes every frame queued and draws only the newest, so
+// when it falls behind the frames in between are dropped. If the queue is
+// full the editing thread holds on to its newest frame (dropping the one it
+// held) and hands it over on retry().
+
+class Render_thread {
+public:
+    // ncurses must be set up already. The thread starts with SIGWINCH
+    // blocked, so resizes interrupt the editing thread's wait for keys.
+    // Throws if the eventfd cannot be made; without it the thread could
+    // never be woken.
+    Render_thread() : m_wake(eventfd(0, EFD_CLOEXEC)) {
+        if (m_wake < 0) throw std::runtime_error(std::string("Cannot create the render thread's eventfd: ") + strerror(errno));
+        sigset_t winch, previous;
+        sigemptyset(&winch);
+        sigaddset(&winch, SIGWINCH);
+        pthread_sigmask(SIG_BLOCK, &winch, &previous);
+        m_thread = std::thread([this] { loop(); });
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    }
+
+    ~Render_thread() {
+        m_stopping.store(true, std::memory_order_release);
+        wake();
+        m_thread.join();
+        close(m_wake);
+    }
+
+    Render_thread(const Render_thread&) = delete;
+    Render_thread& operator=(const Render_thread&) = delete;
+
+    // Hands `frame` over without waiting.
+    void show(std::unique_ptr<const Frame> frame) {
+        m_held = std::move(frame);
+        retry();
+    }
+
+    // Hands over the frame held back by a full queue, if there is one;
+    // true if one is still held.
+    bool retry() {
+        if (m_held && m_queue.try_push(m_held)) wake();
+        return m_held != nullptr;
+    }
+
+private:
+    Spsc_queue<std::unique_ptr<const Frame>, 8> m_queue;
+    std::unique_ptr<const Frame> m_held; // Editing thread only
+    std::atomic<bool> m_stopping{false};
+    int m_wake;
+    std::thread m_thread;
+
+    void wake() {
+        uint64_t one = 1;
+        (void)!write(m_wake, &one, sizeof(one));
+    }
+
+    void loop() {
+        while (!m_stopping.load(std::memory_order_acquire)) {
+            uint64_t count;
+            if (read(m_wake, &count, sizeof(count)) < 0) continue;
+            std::unique_ptr<const Frame> newest, next;
+            while (m_queue.try_pop(next)) newest = std::move(next); // The older ones are dropped here
+            if (newest) draw(*newest);
+        }
+    }
+
+    static void draw(const Frame& frame) {
+        if (frame.rows != LINES || frame.cols != COLS) resizeterm(frame.rows, frame.cols);
+        erase();
+        for (size_t y = 0; y < frame.lines.size(); y++) {
+            const Frame::Row& row = frame.lines[y];
+            int at = static_cast<int>(y);
+            mvaddnstr(at, 0, row.text.c_str(), static_cast<int>(row.text.size()));
+            if (!row.marker.empty() && row.width < frame.cols) {
+                attron(A_DIM);
+                mvaddnstr(at, row.width, row.marker.c_str(), frame.cols - row.width);
+                attroff(A_DIM);
+            }
+            for (int x : row.cursors) mvchgat(at, x, 1, A_REVERSE, 0, nullptr);
+        }
+        attron(A_REVERSE);
+        mvaddnstr(frame.rows - 1, 0, frame.status.c_str(), frame.cols);
+        attroff(A_REVERSE);
+        move(frame.cursor_y, frame.cursor_x);
+        refresh();
+    }
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// A bounded queue between exactly one producer thread and one consumer
+// thread, without locks. The producer only ever writes m_tail and the
+// consumer m_head; each reads the other's with acquire ordering, which
+// makes the slot written before a release store visible after it. The two
+// indexes sit on separate cache lines so the threads do not fight over one.
+// One slot is left empty to tell a full queue from an empty one.
+
+template <typename T, size_t N>
+class Spsc_queue {
+public:
+    // Producer side: false, leaving `value` alone, if the queue is full.
+    bool try_push(T& value) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % N;
+        if (next == m_head.load(std::memory_order_acquire)) return false;
+        m_slots[tail] = std::move(value);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: false if the queue is empty.
+    bool try_pop(T& value) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) return false;
+        value = std::move(m_slots[head]);
+        m_head.store((head + 1) % N, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, N> m_slots;
+    alignas(64) std::atomic<size_t> m_head{0}; // Next slot to pop
+    alignas(64) std::atomic<size_t> m_tail{0}; // Next slot to push
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../__compiler__/Tokenizer.hpp"
+#include "Document.hpp"
+
+// The identifiers in the buffer, for completion. Each distinct identifier is
+// a path in a trie; a node counts how many times its word occurs in the
+// buffer and how many occurrences lie below it. Edits only subtract the old
+// lines' identifiers and add the new lines', so the trie never rescans the
+// file. Completing a prefix walks to its node and then only into branches
+// whose count is non-zero, which takes time in proportion to the answers,
+// not to the number of identifiers.
+//
+// Nodes are never freed: an identifier that disappears from the buffer just
+// drops to a count of zero, and is ready if it is typed again.
+
+class Symbol_trie {
+public:
+    Symbol_trie() : m_nodes(1) {}
+
+    // Keeps the trie in step with `document`, a batch at a time (see
+    // Document); call before loading it.
+    void attach(Document& document) {
+        document.on_edit([this](const Document& doc, const Line_edits& edits) {
+            for (const Line_edit& edit : edits) {
+                for (const auto& line : edit.old_lines) update_line(line, -1);
+                for (size_t i = edit.first; i < edit.first + edit.new_count; i++) update_line(doc.line(i), +1);
+            }
+        }, true);
+    }
+
+    void add(std::string_view word) { update(word, +1); }
+    void remove(std::string_view word) { update(word, -1); }
+
+    // Up to `limit` identifiers starting with `prefix` (the prefix itself
+    // included if it occurs), in byte order.
+    std::vector<std::string> complete(std::string_view prefix, size_t limit) const {
+        std::vector<std::string> words;
+        uint32_t node = 0;
+        for (char c : prefix) {
+            node = child(node, c);
+            if (node == NONE) return words;
+        }
+        std::string word(prefix);
+        collect(node, word, limit, words);
+        return words;
+    }
+
+    // Occurrences of `word` in the buffer.
+    uint32_t count(std::string_view word) const {
+        uint32_t node = 0;
+        for (char c : word) {
+            node = child(node, c);
+            if (node == NONE) return 0;
+        }
+        return m_nodes[node].count;
+    }
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node {
+        std::vector<std::pair<char, uint32_t>> children; // Sorted by byte
+        uint32_t count = 0;  // Occurrences of the word ending here
+        uint32_t below = 0;  // Occurrences of words ending here or further down
+    };
+    std::vector<Node> m_nodes; // m_nodes[0] is the root (the empty prefix)
+
+    void update_line(std::string_view line, int delta) {
+        Tokenizer tokenizer(line);
+        for (const Token& token : tokenizer.tokenize()) {
+            if (token.type == TokenType::IDENTIFIER) update(token.literal, delta);
+        }
+    }
+
+    void update(std::string_view word, int delta) {
+        uint32_t node = 0;
+        m_nodes[0].below += delta;
+        for (char c : word) {
+            uint32_t next = child(node, c);
+            if (next == NONE) next = add_child(node, c);
+            node = next;
+            m_nodes[node].below += delta;
+        }
+        m_nodes[node].count += delta;
+    }
+
+    uint32_t child(uint32_t node, char c) const {
+        const auto& children = m_nodes[node].children;
+        auto it = std::lower_bound(children.begin(), children.end(), c,
+                                   [](const std::pair<char, uint32_t>& p, char key) { return p.first < key; });
+        return it != children.end() && it->first == c ? it->second : NONE;
+    }
+
+    uint32_t add_child(uint32_t node, char c) {
+        uint32_t added = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.emplace_back(); // May move m_nodes: look `node` up again below
+        auto& children = m_nodes[node].children;
+        auto it = std::lower_bound(children.begin(), children.end(), c,
+                                   [](const std::pair<char, uint32_t>& p, char key) { return p.first < key; });
+        children.insert(it, {c, added});
+        return added;
+    }
+
+    // Depth-first, with an explicit stack so a very long identifier cannot
+    // overflow the call stack.
+    void collect(uint32_t start, std::string& word, size_t limit, std::vector<std::string>& words) const {
+        struct Frame {
+            uint32_t node;
+            size_t next_child;
+        };
+        std::vector<Frame> stack{{start, 0}};
+        if (m_nodes[start].below == 0) return;
+        if (m_nodes[start].count && words.size() < limit) words.push_back(word);
+        while (!stack.empty() && words.size() < limit) {
+            Frame& frame = stack.back();
+            const auto& children = m_nodes[frame.node].children;
+            if (frame.next_child == children.size()) {
+                stack.pop_back();
+                if (!stack.empty()) word.pop_back();
+                continue;
+            }
+            auto [c, next] = children[frame.next_child++];
+            if (m_nodes[next].below == 0) continue;
+            word.push_back(c);
+            if (m_nodes[next].count) words.push_back(word);
+            stack.push_back({next, 0});
+        }
+    }
+};
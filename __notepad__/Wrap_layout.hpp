@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Column_map.hpp"
+#include "Document.hpp"
+
+// Soft wrapping: how each line of the document is cut into screen rows of a
+// given width, in columns (see Column_map). A row ends after the last space
+// that fits, or after the last character that fits if there is none. The
+// last row of a line is kept shorter than the width so the cursor always has
+// room after its text.
+//
+// Layouts are computed when a line is first drawn or moved through and then
+// cached with the line's Column_map. An edit drops only the cache entries of
+// the lines it replaced, and a resize just changes the width: each entry
+// remembers the width it was cut for and is recut (keeping its column map)
+// on its next use. So scrolling and vertical movement cost in proportion to
+// the lines on screen, not to the file.
+
+struct Screen_row {
+    size_t line = 0;
+    size_t row = 0; // Which of the line's rows
+};
+
+class Wrap_layout {
+public:
+    // Keeps the cache in step with `document`; call before loading it.
+    void attach(Document& document) {
+        document.on_edit([this](const Document&, const Line_edits& edits) {
+            apply_edits(m_lines, edits, [](size_t) { return Layout{}; });
+        });
+    }
+
+    // The width of a row, in columns; at least 2.
+    void set_width(size_t width) { m_width = width < 2 ? 2 : width; }
+    size_t width() const { return m_width; }
+
+    size_t row_count(const Document& document, size_t line) { return layout(document, line).starts.size() + 1; }
+
+    // The first column of row `row` of `line`, and the column just past it.
+    size_t row_start(const Document& document, size_t line, size_t row) {
+        return row == 0 ? 0 : layout(document, line).starts[row - 1];
+    }
+    size_t row_end(const Document& document, size_t line, size_t row) {
+        const Layout& l = layout(document, line);
+        return row < l.starts.size() ? l.starts[row] : document.line(line).size();
+    }
+
+    // The row of `line` that shows byte `column`. A column where a row
+    // breaks belongs to the row it starts.
+    size_t row_of(const Document& document, size_t line, size_t column) {
+        const auto& starts = layout(document, line).starts;
+        return std::upper_bound(starts.begin(), starts.end(), column) - starts.begin();
+    }
+
+    const Column_map& columns(const Document& document, size_t line) { return mapped(document, line).columns; }
+
+private:
+    struct Layout {
+        bool mapped = false;          // Whether `columns` is filled in
+        Column_map columns;
+        size_t width = 0;             // The width it was cut for; 0 if never
+        std::vector<uint32_t> starts; // Byte where each row after the first begins
+    };
+    std::vector<Layout> m_lines = std::vector<Layout>(1); // One per document line
+    size_t m_width = 80;
+
+    Layout& mapped(const Document& document, size_t line) {
+        Layout& l = m_lines[line];
+        if (!l.mapped) {
+            l.columns = Column_map(document.line(line));
+            l.mapped = true;
+        }
+        return l;
+    }
+
+    const Layout& layout(const Document& document, size_t line) {
+        Layout& l = mapped(document, line);
+        if (l.width == m_width) return l;
+        l.width = m_width;
+        l.starts.clear();
+        const std::string& text = document.line(line);
+        const Column_map& columns = l.columns;
+        size_t start = 0;
+        while (columns.width() - columns.column_of(start) >= m_width) {
+            size_t end = columns.byte_at(columns.column_of(start) + m_width);
+            if (end == start) end = columns.next(start); // Wider than a row: it gets one to itself
+            // Break after the row's last space past its first byte; only the
+            // row is searched, or a line without spaces would be searched back
+            // to its beginning for every row.
+            std::string_view row(text.data() + start + 1, end - start - 1);
+            size_t space = row.rfind(' ');
+            if (space != std::string_view::npos) end = start + 1 + space + 1;
+            l.starts.push_back(static_cast<uint32_t>(end));
+            start = end;
+        }
+        return l;
+    }
+};
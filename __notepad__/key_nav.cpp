@@ -1,133 +1,469 @@
 #include <iostream>
+#include <clocale>
+#include <csignal>
 #include <cstdio>
+#include <memory>
 #include <ncurses.h>
 #include <string.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <vector>
 
-int read_file(const char* file) {
-    FILE* fp = fopen(file, "r");
-    if (!fp) return 0;
+#include "Bracket_index.hpp"
+#include "Cursors.hpp"
+#include "Document.hpp"
+#include "File_sync.hpp"
+#include "Folds.hpp"
+#include "Key_reader.hpp"
+#include "Render_thread.hpp"
+#include "Symbol_trie.hpp"
+#include "Wrap_layout.hpp"
 
-    char ch[1024];
-    while (fgets(ch, sizeof(ch), fp) != NULL) {
-        printw("%s", ch);
+// The editor keeps the text in a Document and, after every key, builds the
+// screen from it as a Frame for the Render_thread to draw; the screen is
+// never read back. Keys are read, and the document edited, on the main
+// thread, which never waits for the terminal to take a redraw. The bottom
+// row is a status line. Tab completes the identifier before the cursor
+// from a Symbol_trie; Ctrl+B jumps between matching brackets and Ctrl+F
+// folds or opens the { } block around the cursor, both through a
+// Bracket_index. Long lines are soft-wrapped by a Wrap_layout; the screen
+// scrolls by rows, not lines.
+// The text is UTF-8: the cursor moves, and Backspace deletes, a whole
+// character (grapheme cluster) at a time, and screen columns come from each
+// line's Column_map. Drawing it needs the wide-character ncurses (ncursesw).
+// When another program saves the file, File_sync takes in the lines it
+// changed, keeping the edits made here, and the cursor stays with the text
+// around it.
+//
+// Ctrl+R starts and stops recording a macro; Ctrl+E asks how many times to
+// run it and runs it as one batch of edits, drawing only at the end.
+//
+// Ctrl+D adds a cursor on the row below the last one added, and Escape
+// goes back to one. Typing, Enter and Backspace act at every cursor (see
+// Cursors); the arrows move them all; Tab, Ctrl+B and Ctrl+F use the
+// primary one, the last added, which the screen follows.
+
+// Steps `at` to the next / previous screen row, passing over folded lines.
+// False, leaving `at` alone, at the end / start of the document.
+bool next_row(const Document& doc, const Folds& folds, Wrap_layout& layout, Screen_row& at) {
+    if (at.row + 1 < layout.row_count(doc, at.line)) {
+        at.row++;
+        return true;
+    }
+    size_t line = folds.next_visible(at.line);
+    if (line >= doc.line_count()) return false;
+    at = {line, 0};
+    return true;
+}
+bool previous_row(const Document& doc, const Folds& folds, Wrap_layout& layout, Screen_row& at) {
+    if (at.row > 0) {
+        at.row--;
+        return true;
+    }
+    if (at.line == 0) return false;
+    size_t line = folds.previous_visible(at.line);
+    at = {line, layout.row_count(doc, line) - 1};
+    return true;
+}
+
+// The bytes [start, end) of `text` as they show on screen: tabs become the
+// spaces to the columns the line's map gives them.
+std::string row_text(const std::string& text, size_t start, size_t end, const Column_map& columns) {
+    std::string shown;
+    size_t from = start;
+    for (size_t i = start; i <= end; i++) {
+        if (i < end && text[i] != '\t') continue;
+        shown.append(text, from, i - from);
+        if (i < end) shown.append(columns.column_of(i + 1) - columns.column_of(i), ' ');
+        from = i + 1;
+    }
+    return shown;
+}
+
+// The screen rows from `top` that fit above the status line of a `rows` by
+// `cols` terminal, with the cursors other than the primary marked, and the
+// terminal's cursor on the primary.
+std::unique_ptr<const Frame> build_frame(const Document& doc, const Folds& folds, Wrap_layout& layout, Screen_row top,
+                                         const Cursors& cursors, const std::string& status, int rows, int cols) {
+    auto frame = std::make_unique<Frame>();
+    frame->rows = rows;
+    frame->cols = cols;
+    frame->status = status;
+    Position cursor = cursors.primary();
+    const std::vector<Position>& all = cursors.all();
+    size_t cursor_row = layout.row_of(doc, cursor.line, cursor.column);
+    Screen_row at = top;
+    for (int y = 0; y < rows - 1; y++) {
+        const Column_map& columns = layout.columns(doc, at.line);
+        size_t start = layout.row_start(doc, at.line, at.row), end = layout.row_end(doc, at.line, at.row);
+        Frame::Row& row = frame->lines.emplace_back();
+        row.text = row_text(doc.line(at.line), start, end, columns);
+        row.width = static_cast<int>(columns.column_of(end) - columns.column_of(start));
+        auto fold = folds.starting(at.line);
+        if (fold && at.row + 1 == layout.row_count(doc, at.line)) {
+            row.marker = " ... " + std::to_string(fold->second - fold->first) + " lines";
+        }
+        if (at.line == cursor.line && at.row == cursor_row) {
+            frame->cursor_y = y;
+            frame->cursor_x = static_cast<int>(columns.column_of(cursor.column) - columns.column_of(start));
+        }
+        for (auto it = std::lower_bound(all.begin(), all.end(), Position{at.line, start});
+             it != all.end() && it->line == at.line && layout.row_of(doc, at.line, it->column) == at.row; ++it) {
+            if (*it == cursor) continue;
+            row.cursors.push_back(static_cast<int>(columns.column_of(it->column) - columns.column_of(start)));
+        }
+        if (!next_row(doc, folds, layout, at)) break;
+    }
+    return frame;
+}
+
+// The terminal's size, asked of the terminal itself: ncurses is the render
+// thread's.
+void terminal_size(int& rows, int& cols) {
+    winsize size{};
+    bool known = ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0;
+    rows = known ? size.ws_row : 24;
+    cols = known ? size.ws_col : 80;
+}
+
+// How many columns into its screen row the cursor is.
+size_t column_in_row(const Document& doc, Wrap_layout& layout, Position cursor) {
+    const Column_map& columns = layout.columns(doc, cursor.line);
+    size_t start = layout.row_start(doc, cursor.line, layout.row_of(doc, cursor.line, cursor.column));
+    return columns.column_of(cursor.column) - columns.column_of(start);
+}
+
+// Up / Down: the cursor moves one screen row, to the character `goal_x`
+// columns into it, or the row's end if it is shorter.
+Position move_vertically(const Document& doc, const Folds& folds, Wrap_layout& layout, Position cursor, bool down,
+                         size_t goal_x) {
+    Screen_row at{cursor.line, layout.row_of(doc, cursor.line, cursor.column)};
+    if (!(down ? next_row(doc, folds, layout, at) : previous_row(doc, folds, layout, at))) return cursor;
+    const Column_map& columns = layout.columns(doc, at.line);
+    size_t start = layout.row_start(doc, at.line, at.row), end = layout.row_end(doc, at.line, at.row);
+    if (at.row + 1 < layout.row_count(doc, at.line)) end = columns.previous(end); // Its end starts the next row
+    return {at.line, std::min(columns.byte_at(columns.column_of(start) + goal_x), end)};
+}
+
+// Ctrl+B: the bracket at the cursor, or else just before it, and its match.
+Position jump_to_match(const Document& doc, const Bracket_index& brackets, Position cursor, std::string& status) {
+    const std::string& line = doc.line(cursor.line);
+    auto is_bracket_at = [&](size_t column) {
+        bool found = false;
+        Bracket_index::for_each_bracket(line, [&](size_t c, char) { found |= c == column; });
+        return found;
+    };
+    Position at = cursor;
+    if (!is_bracket_at(at.column)) {
+        if (at.column == 0 || !is_bracket_at(at.column - 1)) {
+            status = "No bracket at the cursor";
+            return cursor;
+        }
+        at.column--;
+    }
+    auto match = brackets.match(doc, at);
+    if (!match) {
+        status = std::string("Unmatched '") + line[at.column] + "'";
+        return cursor;
+    }
+    char open = line[at.column], close = doc.line(match->line)[match->column];
+    if (Bracket_index::is_close(open)) std::swap(open, close);
+    if (!Bracket_index::match_kind(open, close)) status = std::string("'") + open + "' closed by '" + close + "'";
+    return *match;
+}
+
+// Ctrl+F: opens the fold on the cursor's line, or else folds the innermost
+// { } block that is open at the end of that line and spans several lines,
+// moving the cursor up onto the line left showing.
+Position toggle_fold(const Document& doc, const Bracket_index& brackets, Folds& folds, Position cursor, std::string& status) {
+    if (folds.starting(cursor.line)) {
+        folds.open(cursor.line);
+        return cursor;
+    }
+    auto open = brackets.enclosing(doc, {cursor.line, doc.line(cursor.line).size()}, '{');
+    auto close = open ? brackets.match(doc, *open) : std::nullopt;
+    if (!close || close->line == open->line) {
+        status = "No block to fold";
+        return cursor;
+    }
+    folds.toggle(open->line, close->line);
+    return cursor.line == open->line ? cursor : Position{open->line, doc.line(open->line).size()};
+}
+
+// Tab: completes the identifier that ends at the cursor. One candidate is
+// inserted whole; several are extended to what they share and listed.
+Position complete_identifier(Document& doc, const Symbol_trie& symbols, Position cursor, std::string& status) {
+    const std::string& line = doc.line(cursor.line);
+    size_t start = cursor.column;
+    while (start > 0) {
+        size_t before = start - 1;
+        while (before > 0 && (static_cast<unsigned char>(line[before]) & 0xC0) == 0x80) before--; // To its first byte
+        if (identifier_char_length(line, before, false) != start - before) break;
+        start = before;
+    }
+    std::string prefix = line.substr(start, cursor.column - start);
+    if (prefix.empty() || !identifier_char_length(prefix, 0, true)) {
+        status = "Nothing to complete";
+        return cursor;
+    }
+
+    std::vector<std::string> candidates = symbols.complete(prefix, 16);
+    // The prefix itself is in the trie while it is typed; drop it unless it also occurs elsewhere.
+    if (!candidates.empty() && candidates[0] == prefix && symbols.count(prefix) <= 1) {
+        candidates.erase(candidates.begin());
+    }
+    if (candidates.empty()) {
+        status = "No completions for '" + prefix + "'";
+        return cursor;
+    }
+
+    std::string shared = candidates[0];
+    for (const auto& c : candidates) {
+        size_t n = 0;
+        while (n < shared.size() && n < c.size() && shared[n] == c[n]) n++;
+        shared.resize(n);
+    }
+    status.clear();
+    if (candidates.size() > 1) {
+        for (const auto& c : candidates) status += c + " ";
+    }
+    std::string rest = shared.substr(prefix.size());
+    if (rest.empty()) return cursor;
+    std::string completed = line.substr(0, cursor.column) + rest + line.substr(cursor.column);
+    doc.replace_lines(cursor.line, 1, {std::move(completed)});
+    return {cursor.line, cursor.column + rest.size()};
+}
+
+// Where line `line` goes when a reload replaces lines: after them it moves with
+// them; inside them it keeps its distance from the first, as far as it can.
+size_t after_reload(size_t line, const File_sync::Reloaded& reloaded) {
+    if (line < reloaded.first) return line;
+    if (line >= reloaded.first + reloaded.old_count) return line - reloaded.old_count + reloaded.new_count;
+    size_t offset = line - reloaded.first;
+    return reloaded.first + (offset < reloaded.new_count ? offset : reloaded.new_count ? reloaded.new_count - 1 : 0);
+}
+
+// Asks on the status line for a count; Enter alone means 1, Escape or
+// Ctrl+C means 0. `prompt_with` shows the status line it is given.
+template <typename Show>
+size_t ask_count(Key_reader& keys, const std::string& prompt, Show&& prompt_with) {
+    std::string digits;
+    while (true) {
+        prompt_with(prompt + digits);
+        int key = keys.next(-1).code;
+        if (key >= '0' && key <= '9' && digits.size() < 9) digits += static_cast<char>(key);
+        else if ((key == KEY_BACKSPACE || key == 127 || key == 8) && !digits.empty()) digits.pop_back();
+        else if (key == 10 || key == 13 || key == KEY_ENTER) return digits.empty() ? 1 : std::stoul(digits);
+        else if (key == 27 || key == 3) return 0;
     }
-    fclose(fp);
-    refresh();
-    return 1;
 }
 
-int main() {
-    std::string fln = "notepad_data.txt";
-    int cha;
-    int x = 0, y = 0;
+int main(int argc, char** argv) {
+    std::string fln = argc > 1 ? argv[1] : "notepad_data.txt";
 
+    Document doc;
+    Symbol_trie symbols;
+    Bracket_index brackets;
+    Folds folds;
+    Wrap_layout layout;
+    File_sync sync;
+    symbols.attach(doc);
+    brackets.attach(doc);
+    folds.attach(doc);
+    layout.attach(doc);
+    sync.attach(doc);
+    sync.load(doc, fln);
+    File_watch watch(fln);
+
+    setlocale(LC_ALL, "");  // Let ncurses draw UTF-8
     initscr();              // Start ncurses
     raw();                  // Disable signal processing (get raw characters)
-    keypad(stdscr, TRUE);   // Enable special keys
     noecho();               // Don't echo typed chars
-    FILE* fn = fopen(fln.c_str(), "a+");
-    read_file(fln.c_str());
-    char buffer[1024];
-    getyx(stdscr, y, x);
-    move(y + 1, 0);         // Move cursor to next line after file print
-    printw("Initial Cursor Position: (%d,%d)", x, y);
-    refresh();
-	
+    // A resize only has to cut the wait for a key short (see Key_reader), so
+    // this replaces ncurses's handler, which would touch the screen from here.
+    struct sigaction winch{};
+    winch.sa_handler = [](int) {};
+    sigemptyset(&winch.sa_mask);
+    sigaction(SIGWINCH, &winch, nullptr);
+    Key_reader keys(STDIN_FILENO);
+    std::unique_ptr<Render_thread> renderer;
+    try {
+        renderer = std::make_unique<Render_thread>();
+    } catch (const std::exception& e) {
+        endwin();
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    Cursors cursors;        // Where edits happen, in the document
+    Screen_row top;         // First row on screen
+    size_t goal_x = 0;      // Column Up and Down aim for, kept while they repeat
+    bool vertical = false;  // Whether the last key was Up or Down
+    bool recording = false; // Whether keys are going into `macro`
+    std::vector<Key> macro;
+    std::string status = fln;
+    int rows, cols;
+    terminal_size(rows, cols);
+    layout.set_width(cols);
+    renderer->show(build_frame(doc, folds, layout, top, cursors, status, rows, cols));
+
+    // Does what `key` asks to the document and the cursors, without drawing.
+    auto apply = [&](const Key& key, std::string& message) {
+        int cha = key.code;
+        bool was_vertical = vertical;
+        vertical = false;
+        Position cursor = cursors.primary();
+        switch (cha) {
+            case KEY_UP:
+            case KEY_DOWN:
+                // The primary cursor keeps to the column it started from; the others go from where they are.
+                if (!was_vertical) goal_x = column_in_row(doc, layout, cursor);
+                cursors.move_each([&](Position at, bool primary) {
+                    size_t goal = primary ? goal_x : column_in_row(doc, layout, at);
+                    return move_vertically(doc, folds, layout, at, cha == KEY_DOWN, goal);
+                });
+                vertical = true;
+                break;
+            case KEY_RESIZE:
+                break;
+            case KEY_LEFT:
+                cursors.move_each([&](Position at, bool) {
+                    if (at.column > 0) return Position{at.line, layout.columns(doc, at.line).previous(at.column)};
+                    if (at.line > 0) return Position{at.line - 1, doc.line(at.line - 1).size()};
+                    return at;
+                });
+                break;
+            case KEY_RIGHT:
+                cursors.move_each([&](Position at, bool) {
+                    if (at.column < doc.line(at.line).size()) return Position{at.line, layout.columns(doc, at.line).next(at.column)};
+                    if (at.line + 1 < doc.line_count()) return Position{at.line + 1, 0};
+                    return at;
+                });
+                break;
+            case KEY_BACKSPACE:
+            case 127:
+            case 8:
+                cursors.erase_before(doc, layout);
+                break;
+            case 10: // Enter key (ASCII '\n') — KEY_ENTER often doesn't trigger as expected
+            case 13:
+            case KEY_ENTER:
+                cursors.split_lines(doc);
+                break;
+            case 4: // Ctrl+D
+                if (!was_vertical) goal_x = column_in_row(doc, layout, cursor);
+                cursors.add(move_vertically(doc, folds, layout, cursor, true, goal_x));
+                vertical = true; // Ctrl+D again keeps the same column
+                break;
+            case 27: // Escape
+                cursors.keep_primary();
+                break;
+            // The indexes these ask are brought up to date first, in case a macro is running.
+            case 9: // Tab
+                doc.flush();
+                cursors.keep_primary();
+                cursors.set_primary(complete_identifier(doc, symbols, cursor, message));
+                break;
+            case 2: // Ctrl+B
+                doc.flush();
+                cursors.set_primary(jump_to_match(doc, brackets, cursor, message));
+                break;
+            case 6: // Ctrl+F
+                doc.flush();
+                cursors.set_primary(toggle_fold(doc, brackets, folds, cursor, message));
+                break;
+            default:
+                // Insert typed character at every cursor
+                if (!key.text.empty()) cursors.insert(doc, key.text);
+                break;
+        }
+        cursors.move_each([&](Position at, bool) {
+            at = doc.clamp(at);
+            if (auto fold = folds.folding(at.line)) folds.open(fold->first); // Never leave a cursor hidden
+            return at;
+        });
+    };
+
     while (1) {
-        cha = getch();
-        if (cha == 3 || cha == 26) {  // Ctrl+C or Ctrl+Z
+        // Every 250 ms without a key, the file is checked; sooner while a frame waits for the renderer.
+        Key key = keys.next(renderer->retry() ? 10 : 250);
+        if (key.code == 3 || key.code == 26) {  // Ctrl+C or Ctrl+Z
             break;
-        } else {
-            getyx(stdscr, y, x);
-            switch (cha) {
-                case KEY_UP:
-                    move(y - 1, x);
-                    break;
-                case KEY_DOWN:
-                    move(y + 1, x);
-                    break;
-                case KEY_LEFT:
-                    move(y, x - 1);
-                    break;
-                case KEY_RIGHT:
-                    move(y, x + 1);
-                    break;
-				case KEY_BACKSPACE:
-					getyx(stdscr,y,x);
-                    if (x!=0){
-                        move(y,x-1);
-                        delch();
-                    }
-                    else{
-                        char a[1024];
-                        char strin[50];
-                        mvinnstr(y, 0, a, sizeof(a) - 1);
-                        insdelln(-1);
-                        mvinnstr(y-1, 0, strin, sizeof(strin) - 1);
-                        mvaddstr(y-1, strlen(strin), a);
-                    } 
-					break;
-				case 10: // Enter key (ASCII '\n') — KEY_ENTER often doesn't trigger as expected
-
-                    getyx(stdscr, y, x);
-
-                    // Read the current line into buffer
-                    char line[1024];
-                    mvinnstr(y, 0, line, sizeof(line) - 1);
-
-                    // Split into left and right parts at cursor
-                    char left[1024], right[1024];
-                    strncpy(left, line, x);
-                    left[x] = '\0';
-                    strcpy(right, line + x);
-
-                    // Overwrite current line with left
-                    move(y, 0);
-                    clrtoeol();
-                    printw("%s", left);
-
-                    // Shift down lines if needed (optional for advanced editor)
-
-                    // Move to next line and print right side
-                    move(y + 1, 0);
-                    insdelln(1);  // Insert a blank line below
-                    printw("%s", right);
-
-                    // Move cursor to start of new line
-                    move(y + 1, 0);
-                    break;
-
-
-                default:
-                    // Insert typed character at current cursor position
-                    getyx(stdscr, y, x);
-                    char line[1024];
-                    mvinnstr(y, 0, line, sizeof(line) - 1);
-
-                    // Split line at cursor
-                    char left[1024], right[1024];
-                    strncpy(left, line, x);
-                    left[x] = '\0';
-                    strcpy(right, line + x);    
-
-                    // Build new line with inserted character
-                    char new_line[1024];
-                    snprintf(new_line, sizeof(new_line), "%s%c%s", left, cha, right);
-
-                    // Overwrite current line
-                    move(y, 0);
-                    clrtoeol();
-                    printw("%s", new_line);
-
-                    // Move cursor after inserted character
-                    move(y, x + 1);
-                    break;
+        }
+        std::string message;
+        auto reloaded = watch.changed() ? sync.reload(doc, fln) : std::vector<File_sync::Reloaded>{};
+        if (key.code == ERR && reloaded.empty()) continue;
+        if (!reloaded.empty()) {
+            size_t changed = 0;
+            for (const auto& run : reloaded) {
+                top.line = after_reload(top.line, run);
+                changed += run.new_count;
+            }
+            cursors.move_each([&](Position at, bool) {
+                for (const auto& run : reloaded) at.line = after_reload(at.line, run);
+                at = doc.clamp(at);
+                // The line under the cursor may be new: stay on a character's first byte.
+                const Column_map& columns = layout.columns(doc, at.line);
+                return Position{at.line, columns.byte_at(columns.column_of(at.column))};
+            });
+            message = "Reloaded " + std::to_string(changed) + " changed line(s) from " + fln;
+        }
+        terminal_size(rows, cols);
+        layout.set_width(cols);
 
+        if (key.code == 18) { // Ctrl+R
+            recording = !recording;
+            if (recording) macro.clear();
+            message = recording ? "Recording macro (Ctrl+R to stop)" : "Recorded " + std::to_string(macro.size()) + " key(s)";
+        } else if (key.code == 5) { // Ctrl+E
+            size_t times = recording || macro.empty() ? 0 : ask_count(keys, "Run macro how many times: ", [&](const std::string& prompt) {
+                renderer->show(build_frame(doc, folds, layout, top, cursors, prompt, rows, cols));
+            });
+            size_t runs = 0;
+            doc.begin_batch();
+            for (; runs < times; runs++) {
+                // Stop early once a run changes nothing: it would only repeat itself.
+                size_t revision = doc.revision();
+                Position before = cursors.primary();
+                for (const Key& k : macro) apply(k, message);
+                if (doc.revision() == revision && cursors.primary() == before) break;
             }
-            refresh();
+            doc.end_batch();
+            if (message.empty()) {
+                message = recording ? "Stop recording first" : macro.empty() ? "No macro recorded" : "Ran macro " + std::to_string(runs) + " time(s)";
+            }
+        } else if (key.code != ERR) {
+            if (recording) macro.push_back(key);
+            apply(key, message);
         }
+
+        // Scroll so the primary cursor's row is on screen, counting only the
+        // rows between: the top row, moved by edits, is first put back on the text.
+        Position cursor = cursors.primary();
+        size_t text_rows = rows > 1 ? rows - 1 : 1;
+        Screen_row at{cursor.line, layout.row_of(doc, cursor.line, cursor.column)};
+        if (top.line >= doc.line_count()) top = {doc.line_count() - 1, 0};
+        if (auto fold = folds.folding(top.line)) top = {fold->first, 0};
+        top.row = std::min(top.row, layout.row_count(doc, top.line) - 1);
+        if (at.line < top.line || (at.line == top.line && at.row < top.row)) top = at;
+        Screen_row row = top;
+        size_t shown = 1;
+        while ((row.line != at.line || row.row != at.row) && shown <= text_rows && next_row(doc, folds, layout, row)) {
+            shown++;
+        }
+        if (shown > text_rows) {
+            top = at;
+            for (size_t k = 1; k < text_rows && previous_row(doc, folds, layout, top); k++) {}
+        }
+        size_t column = layout.columns(doc, cursor.line).column_of(cursor.column); // On screen, not in bytes
+        status = message.empty() ? fln + "  " + std::to_string(cursor.line + 1) + ":" + std::to_string(column + 1)
+                                 : message;
+        if (message.empty() && cursors.count() > 1) status += "  (" + std::to_string(cursors.count()) + " cursors)";
+        renderer->show(build_frame(doc, folds, layout, top, cursors, status, rows, cols));
     }
 
+    renderer.reset(); // Its thread stopped before ncurses is closed
     endwin();  // Exit ncurses mode
     return 0;
-}
\ No newline at end of file
+}